@@ -0,0 +1,143 @@
+#include "ai.h"
+#include "book.h"
+#include "trace.h"
+#include "util.h"
+#include <string.h>
+
+// A placement through one unsunk hit is worth this many placements through open water.
+#define HIT_WEIGHT 50
+
+static const struct opening_book* opening_book;
+
+void ai_use_book(const struct opening_book* book) {
+    opening_book = book;
+}
+
+static int in_bounds(int r, int c) {
+    return r >= 0 && c >= 0 && r < BOARD_SIZE && c < BOARD_SIZE;
+}
+
+// Marks squares no ship that's still afloat can use: misses, sunk ships and the squares touching
+// sunk ships, since ships are never placed next to each other.
+static void find_blocked(struct their_board* board, u8 blocked[BOARD_SIZE][BOARD_SIZE]) {
+    for (int r = 0; r < BOARD_SIZE; r++) {
+        for (int c = 0; c < BOARD_SIZE; c++)
+            blocked[r][c] = board->hits[r][c] == MISS;
+    }
+
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        struct placed_ship* sunk = &board->sunk[ship];
+        for (int i = 0; i < sunk->size; i++) {
+            int r = sunk->row + (sunk->dir ? i : 0);
+            int c = sunk->col + (sunk->dir ? 0 : i);
+
+            blocked[r][c] = 1;
+            if (in_bounds(r - 1, c)) blocked[r - 1][c] = 1;
+            if (in_bounds(r + 1, c)) blocked[r + 1][c] = 1;
+            if (in_bounds(r, c - 1)) blocked[r][c - 1] = 1;
+            if (in_bounds(r, c + 1)) blocked[r][c + 1] = 1;
+        }
+    }
+}
+
+static int is_open_hit(struct their_board* board, u8 blocked[BOARD_SIZE][BOARD_SIZE], int r, int c) {
+    return in_bounds(r, c) && board->hits[r][c] == HIT && !blocked[r][c];
+}
+
+// Returns how many unsunk hits the placement covers, or -1 if it can't be where a ship is. A
+// placement that runs alongside a hit without covering it is impossible too: that hit belongs to
+// another ship, and ships don't touch.
+static int score_placement(struct their_board* board, u8 blocked[BOARD_SIZE][BOARD_SIZE], int r, int c, int dir, int size) {
+    int dr = dir ? 1 : 0, dc = dir ? 0 : 1;
+
+    if (!in_bounds(r + dr * (size - 1), c + dc * (size - 1)))
+        return -1;
+
+    if (is_open_hit(board, blocked, r - dr, c - dc) || is_open_hit(board, blocked, r + dr * size, c + dc * size))
+        return -1;
+
+    int hits = 0;
+    for (int i = 0; i < size; i++) {
+        int cr = r + dr * i, cc = c + dc * i;
+        if (blocked[cr][cc])
+            return -1;
+
+        if (is_open_hit(board, blocked, cr + dc, cc + dr) || is_open_hit(board, blocked, cr - dc, cc - dr))
+            return -1;
+
+        if (board->hits[cr][cc] == HIT)
+            hits++;
+    }
+
+    return hits;
+}
+
+void ai_heat_map(struct their_board* board, const struct placement_prior* prior, float heat[BOARD_SIZE][BOARD_SIZE]) {
+    u8 blocked[BOARD_SIZE][BOARD_SIZE];
+    find_blocked(board, blocked);
+
+    memset(heat, 0, sizeof(float) * BOARD_SIZE * BOARD_SIZE);
+
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        if (board->sunk[ship].size)
+            continue;
+
+        int size = ship_size((enum ship)ship);
+        for (int r = 0; r < BOARD_SIZE; r++) {
+            for (int c = 0; c < BOARD_SIZE; c++) {
+                for (int dir = 0; dir < 2; dir++) {
+                    int hits = score_placement(board, blocked, r, c, dir, size);
+                    if (hits < 0)
+                        continue;
+
+                    float weight = 1 + HIT_WEIGHT * hits;
+                    for (int i = 0; i < size; i++) {
+                        int cr = r + (dir ? i : 0), cc = c + (dir ? 0 : i);
+                        if (board->hits[cr][cc] == HS_NONE)
+                            heat[cr][cc] += weight;
+                    }
+                }
+            }
+        }
+    }
+
+    if (prior) {
+        for (int r = 0; r < BOARD_SIZE; r++) {
+            for (int c = 0; c < BOARD_SIZE; c++)
+                heat[r][c] *= prior->scale[r][c];
+        }
+    }
+}
+
+int ai_choose_shot(struct their_board* board, const struct placement_prior* prior, struct rng* rng, int* r, int* c) {
+    TRACE_SCOPE("ai_choose_shot");
+
+    // The book was built without a prior, so it only speaks for opponents we know nothing about.
+    if (opening_book && !prior && book_lookup(opening_book, board, rng, r, c) == 0)
+        return 0;
+
+    float heat[BOARD_SIZE][BOARD_SIZE];
+    ai_heat_map(board, prior, heat);
+
+    int ties = 0;
+    float best = -1;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            if (board->hits[i][j] != HS_NONE || heat[i][j] < best)
+                continue;
+
+            if (heat[i][j] > best) {
+                best = heat[i][j];
+                ties = 0;
+            }
+
+            // Reservoir sampling: the n-th tie replaces the pick with probability 1/n.
+            if (ties++ == 0 || (rng && rng_range(rng, ties) == 0)) {
+                *r = i;
+                *c = j;
+            }
+        }
+    }
+
+    return ties ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef _AI_H
+#define _AI_H
+
+#include "board.h"
+
+// How much more (or less) likely than usual each square is to hold a ship. NULL, or 1 everywhere,
+// means we know nothing about the opponent.
+struct placement_prior {
+    float scale[BOARD_SIZE][BOARD_SIZE];
+};
+
+// Scores every square by how many legal placements of the ships still afloat cover it, weighted
+// heavily toward placements through squares we've hit but not sunk yet. Squares already shot at
+// score 0.
+void ai_heat_map(struct their_board* board, const struct placement_prior* prior, float heat[BOARD_SIZE][BOARD_SIZE]);
+
+struct opening_book;
+
+// Picks the hottest square that hasn't been shot at, breaking ties at random if rng is given.
+// Early positions come from the opening book instead, if one is in use. Returns -1 if there's
+// nothing left to shoot.
+int ai_choose_shot(struct their_board* board, const struct placement_prior* prior, struct rng* rng, int* r, int* c);
+
+// Makes ai_choose_shot consult a book (see book.h) first, NULL to stop. The book has to stay open.
+void ai_use_book(const struct opening_book* book);
+
+#endif
\ No newline at end of file
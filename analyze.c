@@ -0,0 +1,418 @@
+#include "analyze.h"
+#include "replay.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Column file layout, in native byte order since it's a local cache of the replay file:
+//   struct column_header
+//   occupancy   u64[2 * game_count]    squares covered by our ships, bits 0-63 and 64-99
+//   move_start  u32[game_count + 1]    index of each game's first move
+//   first       u8[game_count]         1 if we went first
+//   won         u8[game_count]
+//   ours        u8[move_count]         1 if we fired the shot
+//   cell        u8[move_count]         row * BOARD_SIZE + col
+//   result      u8[move_count]         enum net_move_result
+//   ship        u8[move_count]         ship sunk by the shot, if any
+#define COLUMN_MAGIC "BSCL"
+#define COLUMN_VERSION 1
+
+struct column_header {
+    char magic[4];
+    u32 version;
+    u64 game_count, move_count;
+};
+
+struct columns {
+    u64 game_count, move_count;
+    const u64* occupancy;
+    const u32* move_start;
+    const u8* first;
+    const u8* won;
+    const u8* ours;
+    const u8* cell;
+    const u8* result;
+    const u8* ship;
+};
+
+// Growable array for building a column.
+struct column_builder {
+    char* data;
+    size_t length, capacity;
+};
+
+static void column_push(struct column_builder* column, const void* value, size_t size) {
+    if (column->length + size > column->capacity) {
+        column->capacity = column->capacity ? column->capacity * 2 : 4096;
+        column->data = realloc(column->data, column->capacity);
+        if (!column->data) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    memcpy(column->data + column->length, value, size);
+    column->length += size;
+}
+
+static int write_column(FILE* file, struct column_builder* column) {
+    return fwrite(column->data, 1, column->length, file) == column->length ? 0 : -1;
+}
+
+static int convert(const char* replay_path, const char* column_path) {
+    FILE* in = fopen(replay_path, "rb");
+    if (!in) {
+        perror("replay file error");
+        return -1;
+    }
+
+    if (replay_read_header(in)) {
+        fprintf(stderr, "%s is not a replay file\n", replay_path);
+        fclose(in);
+        return -1;
+    }
+
+    struct column_builder occupancy = {0}, move_start = {0}, first = {0}, won = {0};
+    struct column_builder ours = {0}, cell = {0}, result = {0}, ship = {0};
+    struct column_header header = { .magic = COLUMN_MAGIC, .version = COLUMN_VERSION };
+
+    static struct replay replay;
+    int status;
+
+    while ((status = replay_read(in, &replay)) == 0) {
+        u64 bits[2] = {0};
+        for (int s = AIRCRAFT_CARRIER; s < SHIP_COUNT; s++) {
+            struct placed_ship* placed = &replay.ships[s];
+            for (int i = 0; i < placed->size; i++) {
+                int r = placed->row + (placed->dir ? i : 0);
+                int c = placed->col + (placed->dir ? 0 : i);
+                int idx = r * BOARD_SIZE + c;
+                bits[idx / 64] |= (u64)1 << (idx % 64);
+            }
+        }
+
+        u32 start = (u32)header.move_count;
+        column_push(&occupancy, bits, sizeof bits);
+        column_push(&move_start, &start, sizeof start);
+        column_push(&first, &replay.we_went_first, 1);
+        column_push(&won, &replay.won, 1);
+
+        for (int i = 0; i < replay.move_count; i++) {
+            struct replay_move* move = &replay.moves[i];
+            u8 idx = (u8)(move->row * BOARD_SIZE + move->col);
+            u8 res = (u8)move->result;
+            u8 sunk = (u8)move->ship;
+
+            column_push(&ours, &move->ours, 1);
+            column_push(&cell, &idx, 1);
+            column_push(&result, &res, 1);
+            column_push(&ship, &sunk, 1);
+        }
+
+        header.game_count++;
+        header.move_count += replay.move_count;
+    }
+
+    fclose(in);
+
+    if (status < 0) {
+        fprintf(stderr, "%s is corrupt after %llu games\n", replay_path, (unsigned long long)header.game_count);
+        status = -1;
+        goto done;
+    }
+
+    u32 end = (u32)header.move_count;
+    column_push(&move_start, &end, sizeof end);
+
+    FILE* out = fopen(column_path, "wb");
+    if (!out) {
+        perror("column file error");
+        status = -1;
+        goto done;
+    }
+
+    status = fwrite(&header, sizeof header, 1, out) == 1 ? 0 : -1;
+    status |= write_column(out, &occupancy);
+    status |= write_column(out, &move_start);
+    status |= write_column(out, &first);
+    status |= write_column(out, &won);
+    status |= write_column(out, &ours);
+    status |= write_column(out, &cell);
+    status |= write_column(out, &result);
+    status |= write_column(out, &ship);
+    status |= fclose(out);
+
+    if (status) {
+        perror("column write error");
+        unlink(column_path);
+    }
+
+done:
+    free(occupancy.data);
+    free(move_start.data);
+    free(first.data);
+    free(won.data);
+    free(ours.data);
+    free(cell.data);
+    free(result.data);
+    free(ship.data);
+    return status;
+}
+
+static const void* map_columns(const char* path, size_t* size, struct columns* columns) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("column file error");
+        return NULL;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    *size = st.st_size;
+
+    if (*size < sizeof(struct column_header)) {
+        fprintf(stderr, "%s is not a column file\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    const char* data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("mmap error");
+        return NULL;
+    }
+
+    const struct column_header* header = (const struct column_header*)data;
+    u64 games = header->game_count, moves = header->move_count;
+    // Every game and move takes at least a byte, which also keeps the sum below from overflowing.
+    if (games > *size || moves > *size) {
+        fprintf(stderr, "%s is not a valid column file\n", path);
+        munmap((void*)data, *size);
+        return NULL;
+    }
+    size_t expected = sizeof *header + games * 16 + (games + 1) * 4 + games * 2 + moves * 4;
+
+    if (memcmp(header->magic, COLUMN_MAGIC, 4) != 0 || header->version != COLUMN_VERSION || *size != expected) {
+        fprintf(stderr, "%s is not a valid column file\n", path);
+        munmap((void*)data, *size);
+        return NULL;
+    }
+
+    const char* ptr = data + sizeof *header;
+    columns->game_count = games;
+    columns->move_count = moves;
+    columns->occupancy = (const u64*)ptr;
+    ptr += games * 16;
+    columns->move_start = (const u32*)ptr;
+    ptr += (games + 1) * 4;
+    columns->first = (const u8*)ptr;
+    ptr += games;
+    columns->won = (const u8*)ptr;
+    ptr += games;
+    columns->ours = (const u8*)ptr;
+    ptr += moves;
+    columns->cell = (const u8*)ptr;
+    ptr += moves;
+    columns->result = (const u8*)ptr;
+    ptr += moves;
+    columns->ship = (const u8*)ptr;
+
+    // The scan indexes arrays with these, so the file isn't trusted any more than a replay is.
+    int valid = columns->move_start[0] == 0 && columns->move_start[games] == moves;
+    for (u64 g = 0; g < games && valid; g++) {
+        valid = columns->move_start[g] <= columns->move_start[g + 1]
+            && columns->first[g] <= 1 && columns->won[g] <= 1;
+    }
+    for (u64 m = 0; m < moves && valid; m++)
+        valid = columns->ours[m] <= 1 && columns->cell[m] < BOARD_SIZE * BOARD_SIZE;
+
+    if (!valid) {
+        fprintf(stderr, "%s is not a valid column file\n", path);
+        munmap((void*)data, *size);
+        return NULL;
+    }
+
+    return data;
+}
+
+#define CELL_COUNT (BOARD_SIZE * BOARD_SIZE)
+
+// Everything a scan adds up. Each thread fills its own and they're summed at the end.
+struct aggregates {
+    // Indexed by who went first: [0] they did, [1] we did.
+    u64 games[2], moves[2], wins[2];
+    // First shot of each side.
+    u64 first_shots[CELL_COUNT], first_hits[CELL_COUNT];
+    // Sum of the 0-based position each ship was sunk at, counted separately for each side.
+    u64 sink_position[SHIP_COUNT], sinks[SHIP_COUNT];
+    // How often our ships covered each square.
+    u64 heat[CELL_COUNT];
+};
+
+struct scan_job {
+    const struct columns* columns;
+    u64 begin, end;
+    struct aggregates result;
+};
+
+static void* scan(void* arg) {
+    struct scan_job* job = arg;
+    const struct columns* col = job->columns;
+    struct aggregates* agg = &job->result;
+
+    for (u64 g = job->begin; g < job->end; g++) {
+        u8 first = col->first[g];
+        u32 start = col->move_start[g], end = col->move_start[g + 1];
+
+        agg->games[first]++;
+        agg->moves[first] += end - start;
+        agg->wins[first] += col->won[g];
+
+        int seen_first[2] = {0}, sunk_so_far[2] = {0};
+        for (u32 m = start; m < end; m++) {
+            u8 side = col->ours[m];
+            if (!seen_first[side]) {
+                seen_first[side] = 1;
+                agg->first_shots[col->cell[m]]++;
+                agg->first_hits[col->cell[m]] += col->result[m] != NET_MISS;
+            }
+
+            if (col->result[m] == NET_SINK && col->ship[m] < SHIP_COUNT) {
+                agg->sink_position[col->ship[m]] += sunk_so_far[side]++;
+                agg->sinks[col->ship[m]]++;
+            }
+        }
+
+        for (int half = 0; half < 2; half++) {
+            u64 bits = col->occupancy[2 * g + half];
+            while (bits) {
+                int idx = half * 64 + __builtin_ctzll(bits);
+                if (idx < CELL_COUNT)
+                    agg->heat[idx]++;
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void merge(struct aggregates* into, struct aggregates* from) {
+    u64* dst = (u64*)into;
+    u64* src = (u64*)from;
+    for (size_t i = 0; i < sizeof(struct aggregates) / sizeof(u64); i++)
+        dst[i] += src[i];
+}
+
+static double ratio(u64 num, u64 den) {
+    return den ? (double)num / den : 0.0;
+}
+
+static void report(struct aggregates* agg, u64 move_count) {
+    u64 games = agg->games[0] + agg->games[1];
+    printf("%llu games, %llu moves\n\n", (unsigned long long)games, (unsigned long long)move_count);
+
+    printf("Game length:\n");
+    printf("  we went first:   %6.1f moves on average, won %5.1f%% of %llu games\n",
+        ratio(agg->moves[1], agg->games[1]), 100 * ratio(agg->wins[1], agg->games[1]), (unsigned long long)agg->games[1]);
+    printf("  they went first: %6.1f moves on average, won %5.1f%% of %llu games\n\n",
+        ratio(agg->moves[0], agg->games[0]), 100 * ratio(agg->wins[0], agg->games[0]), (unsigned long long)agg->games[0]);
+
+    printf("Most common first shots:\n");
+    int taken[CELL_COUNT] = {0};
+    u64 total_first = 0;
+    for (int i = 0; i < CELL_COUNT; i++)
+        total_first += agg->first_shots[i];
+
+    for (int rank = 0; rank < 10; rank++) {
+        int best = -1;
+        for (int i = 0; i < CELL_COUNT; i++) {
+            if (!taken[i] && agg->first_shots[i] > 0 && (best < 0 || agg->first_shots[i] > agg->first_shots[best]))
+                best = i;
+        }
+        if (best < 0)
+            break;
+
+        taken[best] = 1;
+        printf("  %c%-2i %5.1f%% of first shots, hit %5.1f%% of the time\n",
+            best % BOARD_SIZE + 'A', best / BOARD_SIZE + 1,
+            100 * ratio(agg->first_shots[best], total_first),
+            100 * ratio(agg->first_hits[best], agg->first_shots[best]));
+    }
+
+    printf("\nAverage sink order (1 = sunk first):\n");
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        printf("  %-16s %.2f\n", ship_name((enum ship)ship),
+            agg->sinks[ship] ? 1 + ratio(agg->sink_position[ship], agg->sinks[ship]) : 0.0);
+    }
+
+    printf("\nHow often our ships cover each square (%%):\n");
+    printf("     A   B   C   D   E   F   G   H   I   J\n");
+    for (int r = 0; r < BOARD_SIZE; r++) {
+        printf("%2i ", r + 1);
+        for (int c = 0; c < BOARD_SIZE; c++)
+            printf("%4.0f", 100 * ratio(agg->heat[r * BOARD_SIZE + c], games));
+        putchar('\n');
+    }
+}
+
+int analyze(const char* path, int threads) {
+    char column_path[4096];
+    snprintf(column_path, sizeof column_path, "%s.cols", path);
+
+    struct stat replay_st, column_st;
+    if (stat(path, &replay_st) < 0) {
+        perror("replay file error");
+        return -1;
+    }
+
+    if (stat(column_path, &column_st) < 0 || column_st.st_mtime <= replay_st.st_mtime) {
+        fprintf(stderr, "Converting %s to columns...\n", path);
+        if (convert(path, column_path))
+            return -1;
+    }
+
+    struct columns columns;
+    size_t size;
+    const void* data = map_columns(column_path, &size, &columns);
+    if (!data)
+        return -1;
+
+    if (threads < 1)
+        threads = 1;
+    if ((u64)threads > columns.game_count && columns.game_count > 0)
+        threads = (int)columns.game_count;
+
+    struct scan_job* jobs = calloc(threads, sizeof(struct scan_job));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    if (!jobs || !tids) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        jobs[i].columns = &columns;
+        jobs[i].begin = columns.game_count * i / threads;
+        jobs[i].end = columns.game_count * (i + 1) / threads;
+        pthread_create(&tids[i], NULL, scan, &jobs[i]);
+    }
+
+    struct aggregates total = {0};
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        merge(&total, &jobs[i].result);
+    }
+
+    report(&total, columns.move_count);
+
+    free(jobs);
+    free(tids);
+    munmap((void*)data, size);
+    return 0;
+}
\ No newline at end of file
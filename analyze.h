@@ -0,0 +1,9 @@
+#ifndef _ANALYZE_H
+#define _ANALYZE_H
+
+// Converts a replay file into columns (moves, results and placements each stored contiguously)
+// next to it as <path>.cols, then scans the columns on `threads` threads and prints statistics.
+// The conversion is skipped if the column file is newer than the replays. Returns -1 on failure.
+int analyze(const char* path, int threads);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_PATH 1
+#endif
+
+#define SHIPS (SHIP_COUNT - 1)
+
+int batch_init(struct batch* batch, int games) {
+    int count = (games + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+
+    // Aligned so every lane group is one aligned load.
+    size_t words = (size_t)count * (SHIPS * BATCH_WORDS + SHIPS + BATCH_WORDS + 1);
+    u32* storage = aligned_alloc(32, words * sizeof(u32));
+    if (!storage)
+        return -1;
+    memset(storage, 0, words * sizeof(u32));
+
+    batch->count = count;
+    batch->ships = storage;
+    batch->remaining = batch->ships + (size_t)SHIPS * BATCH_WORDS * count;
+    batch->shot = batch->remaining + (size_t)SHIPS * count;
+    batch->ships_left = batch->shot + (size_t)BATCH_WORDS * count;
+    return 0;
+}
+
+void batch_free(struct batch* batch) {
+    free(batch->ships);
+    batch->ships = NULL;
+}
+
+void batch_set_fleet(struct batch* batch, int game, const struct our_board* fleet) {
+    int count = batch->count;
+
+    for (int ship = 0; ship < SHIPS; ship++) {
+        const struct placed_ship* placed = &fleet->placements[ship + 1];
+
+        for (int w = 0; w < BATCH_WORDS; w++)
+            batch->ships[(ship * BATCH_WORDS + w) * count + game] = 0;
+
+        for (int i = 0; i < placed->size; i++) {
+            int square = (placed->row + (placed->dir ? i : 0)) * BOARD_SIZE + placed->col + (placed->dir ? 0 : i);
+            batch->ships[(ship * BATCH_WORDS + square / 32) * count + game] |= 1u << (square % 32);
+        }
+
+        batch->remaining[ship * count + game] = placed->size;
+    }
+
+    for (int w = 0; w < BATCH_WORDS; w++)
+        batch->shot[w * count + game] = 0;
+    batch->ships_left[game] = fleet->ship_count;
+}
+
+// The vector version below is this, one game at a time, step for step.
+int batch_fire_scalar(struct batch* batch, const i32* squares, u8* results, u8* sunk) {
+    int count = batch->count;
+    int won = 0;
+
+    for (int g = 0; g < count; g++) {
+        i32 square = squares[g];
+        i32 word = square >> 5;
+        u32 bit = 1u << (square & 31);
+
+        u32 fired[BATCH_WORDS];
+        u32 any = 0;
+        for (int w = 0; w < BATCH_WORDS; w++) {
+            fired[w] = (word == w ? bit : 0) & ~batch->shot[w * count + g];
+            batch->shot[w * count + g] |= fired[w];
+            any |= fired[w];
+        }
+
+        u32 hit = 0, sunk_ship = 0, sinks = 0;
+        for (int ship = 0; ship < SHIPS; ship++) {
+            u32 overlap = 0;
+            for (int w = 0; w < BATCH_WORDS; w++)
+                overlap |= batch->ships[(ship * BATCH_WORDS + w) * count + g] & fired[w];
+
+            u32 is_hit = overlap != 0;
+            u32 left = batch->remaining[ship * count + g] -= is_hit;
+            u32 is_sunk = is_hit & (left == 0);
+
+            hit |= is_hit;
+            sunk_ship |= is_sunk ? (u32)(ship + 1) : 0;
+            sinks += is_sunk;
+        }
+
+        u32 ships_left = batch->ships_left[g] -= sinks;
+        won += sinks && ships_left == 0;
+
+        results[g] = any ? (hit ? HIT : MISS) : HS_NONE;
+        sunk[g] = (u8)sunk_ship;
+    }
+
+    return won;
+}
+
+#ifdef HAVE_AVX2_PATH
+
+// Narrows 8 lanes holding values below 256 to 8 bytes.
+__attribute__((target("avx2")))
+static void store_bytes(u8* out, __m256i v) {
+    __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    __m128i bytes = _mm_packus_epi16(words, words);
+    _mm_storel_epi64((__m128i*)out, bytes);
+}
+
+__attribute__((target("avx2")))
+static int batch_fire_avx2(struct batch* batch, const i32* squares, u8* results, u8* sunk) {
+    int count = batch->count;
+    int won = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+
+    for (int g = 0; g < count; g += BATCH_LANES) {
+        __m256i square = _mm256_loadu_si256((const __m256i*)&squares[g]);
+        __m256i word = _mm256_srai_epi32(square, 5);
+        __m256i bit = _mm256_sllv_epi32(one, _mm256_and_si256(square, _mm256_set1_epi32(31)));
+
+        __m256i fired[BATCH_WORDS];
+        __m256i any = zero;
+        for (int w = 0; w < BATCH_WORDS; w++) {
+            __m256i* shot = (__m256i*)&batch->shot[w * count + g];
+            __m256i in_word = _mm256_and_si256(_mm256_cmpeq_epi32(word, _mm256_set1_epi32(w)), bit);
+            fired[w] = _mm256_andnot_si256(_mm256_load_si256(shot), in_word);
+            _mm256_store_si256(shot, _mm256_or_si256(_mm256_load_si256(shot), fired[w]));
+            any = _mm256_or_si256(any, fired[w]);
+        }
+
+        // Compare masks are all ones (-1), so adding one is subtracting 1 where it's set.
+        __m256i hit = zero, sunk_ship = zero, sinks = zero;
+        for (int ship = 0; ship < SHIPS; ship++) {
+            __m256i overlap = zero;
+            for (int w = 0; w < BATCH_WORDS; w++) {
+                __m256i ships = _mm256_load_si256((const __m256i*)&batch->ships[(ship * BATCH_WORDS + w) * count + g]);
+                overlap = _mm256_or_si256(overlap, _mm256_and_si256(ships, fired[w]));
+            }
+
+            __m256i is_hit = _mm256_xor_si256(_mm256_cmpeq_epi32(overlap, zero), _mm256_set1_epi32(-1));
+            __m256i* remaining = (__m256i*)&batch->remaining[ship * count + g];
+            __m256i left = _mm256_add_epi32(_mm256_load_si256(remaining), is_hit);
+            _mm256_store_si256(remaining, left);
+            __m256i is_sunk = _mm256_and_si256(is_hit, _mm256_cmpeq_epi32(left, zero));
+
+            hit = _mm256_or_si256(hit, is_hit);
+            sunk_ship = _mm256_or_si256(sunk_ship, _mm256_and_si256(is_sunk, _mm256_set1_epi32(ship + 1)));
+            sinks = _mm256_add_epi32(sinks, is_sunk);
+        }
+
+        __m256i* ships_left = (__m256i*)&batch->ships_left[g];
+        __m256i left = _mm256_add_epi32(_mm256_load_si256(ships_left), sinks);
+        _mm256_store_si256(ships_left, left);
+        __m256i is_win = _mm256_andnot_si256(_mm256_cmpeq_epi32(sinks, zero), _mm256_cmpeq_epi32(left, zero));
+        won += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(is_win)));
+
+        __m256i fired_any = _mm256_xor_si256(_mm256_cmpeq_epi32(any, zero), _mm256_set1_epi32(-1));
+        __m256i result = _mm256_blendv_epi8(_mm256_set1_epi32(MISS), _mm256_set1_epi32(HIT), hit);
+        store_bytes(&results[g], _mm256_and_si256(result, fired_any));
+        store_bytes(&sunk[g], sunk_ship);
+    }
+
+    return won;
+}
+
+#endif
+
+int batch_fire(struct batch* batch, const i32* squares, u8* results, u8* sunk) {
+#ifdef HAVE_AVX2_PATH
+    if (__builtin_cpu_supports("avx2"))
+        return batch_fire_avx2(batch, squares, results, sunk);
+#endif
+    return batch_fire_scalar(batch, squares, results, sunk);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include "board.h"
+
+// Games are resolved this many at a time, one per 32 bit lane of an AVX2 register.
+#define BATCH_LANES 8
+// A board's 100 squares as 32 bit words, square n at bit (n % 32) of word (n / 32).
+#define BATCH_WORDS 4
+
+// Many games kept side by side (structure of arrays) so firing a shot into each of them is a few
+// vector operations instead of a board lookup and counter updates per game. Every array is
+// indexed [... * count + game], so consecutive games sit in consecutive lanes.
+struct batch {
+    // Games, rounded up to a multiple of BATCH_LANES. The extra ones are empty and never shot.
+    int count;
+    // ships[(ship * BATCH_WORDS + word) * count + game]: where each ship (0 is the carrier) is.
+    u32* ships;
+    // remaining[ship * count + game]: squares of each ship not hit yet.
+    u32* remaining;
+    // shot[word * count + game]: squares already fired at.
+    u32* shot;
+    // ships_left[game]: 0 once the game is over.
+    u32* ships_left;
+};
+
+// Returns -1 if out of memory.
+int batch_init(struct batch* batch, int games);
+void batch_free(struct batch* batch);
+// Puts a fleet into a game, clearing whatever was shot there before.
+void batch_set_fleet(struct batch* batch, int game, const struct our_board* fleet);
+
+// Fires squares[game] (row * BOARD_SIZE + col) into every game; -1 sits the game out, as does a
+// square that was already shot. results[game] becomes HIT, MISS or HS_NONE if nothing was fired,
+// and sunk[game] the ship the shot sank or SHIP_NONE. All three arrays hold count entries.
+// Returns how many games this volley won.
+int batch_fire(struct batch* batch, const i32* squares, u8* results, u8* sunk);
+// batch_fire without vector instructions. Gives exactly the same results, it's what batch_fire
+// falls back to on CPUs without AVX2.
+int batch_fire_scalar(struct batch* batch, const i32* squares, u8* results, u8* sunk);
+
+#endif
\ No newline at end of file
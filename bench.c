@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Bump whenever a column changes meaning, so scripts comparing two runs can tell.
+#define BENCH_FORMAT_VERSION 1
+#define MAX_SHOTS (BOARD_SIZE * BOARD_SIZE)
+
+// The smallest shot count at least `fraction` of the games finished within.
+static int percentile(const int* histogram, int games, double fraction) {
+    long needed = (long)(fraction * games + 0.999999), seen = 0;
+    for (int shots = 0; shots <= MAX_SHOTS; shots++) {
+        seen += histogram[shots];
+        if (seen >= needed)
+            return shots;
+    }
+    return MAX_SHOTS;
+}
+
+int bench(const struct strategy** strategies, int count, struct bench_options* options) {
+    int layouts = options->layouts;
+
+    // Placing isn't being measured, so the corpus is built up front, the same way player.c
+    // offers a random fleet.
+    struct our_board* fleets = malloc(layouts * sizeof(struct our_board));
+    if (!fleets) {
+        perror("malloc error");
+        return -1;
+    }
+
+    for (int g = 0; g < layouts; g++) {
+        struct rng rng;
+        rng_seed(&rng, sim_game_seed(options->seed, g, 0));
+        board_init_random(&fleets[g], &rng);
+    }
+
+    printf("# battleship bench %i layouts=%i seed=%llu\n", BENCH_FORMAT_VERSION, layouts, (unsigned long long)options->seed);
+    printf("strategy\tgames\tmoves\tns_per_move\tgames_per_sec\tmean_shots\tp50_shots\tp90_shots\tp99_shots\tmax_shots\n");
+
+    for (int i = 0; i < count; i++) {
+        const struct strategy* strategy = strategies[i];
+        int histogram[MAX_SHOTS + 1] = {0};
+        long moves = 0;
+
+        u64 start = time_ns();
+        for (int g = 0; g < layouts; g++) {
+            struct rng rng;
+            rng_seed(&rng, sim_game_seed(options->seed, g, 1));
+
+            int shots = sim_shots_to_win(&fleets[g], strategy, &rng);
+            if (shots < 0 || shots > MAX_SHOTS) {
+                fprintf(stderr, "%s made an illegal shot\n", strategy->name);
+                free(fleets);
+                return -1;
+            }
+
+            histogram[shots]++;
+            moves += shots;
+        }
+        double seconds = (time_ns() - start) / 1e9;
+
+        printf("%s\t%i\t%ld\t%.1f\t%.1f\t%.3f\t%i\t%i\t%i\t%i\n",
+            strategy->name, layouts, moves,
+            seconds * 1e9 / moves, layouts / seconds, (double)moves / layouts,
+            percentile(histogram, layouts, 0.5), percentile(histogram, layouts, 0.9),
+            percentile(histogram, layouts, 0.99), percentile(histogram, layouts, 1.0));
+        fflush(stdout);
+    }
+
+    free(fleets);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "strategy.h"
+
+struct bench_options {
+    // Fleets in the corpus. Every strategy shoots at all of them.
+    int layouts;
+    u64 seed;
+};
+
+// Plays each strategy against the same seeded corpus of random fleets on one thread and prints
+// how fast it shoots and how many shots it needs, as tab separated columns meant to be diffed
+// between builds. Returns -1 on failure.
+int bench(const struct strategy** strategies, int count, struct bench_options* options);
+
+#endif
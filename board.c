@@ -1,4 +1,6 @@
 #include "board.h"
+#include "trace.h"
+#include <assert.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
@@ -31,6 +33,22 @@ const char* ship_name(enum ship ship) {
     }
 }
 
+int ship_size(enum ship ship) {
+    switch (ship) {
+    case AIRCRAFT_CARRIER:
+        return 5;
+    case BATTLESHIP:
+        return 4;
+    case CRUISER:
+    case SUBMARINE:
+        return 3;
+    case DESTROYER:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
 void ourboard_init(struct our_board *board) {
     memset(board, 0, sizeof(struct our_board));
 }
@@ -41,6 +59,8 @@ void their_board_init(struct their_board* board) {
             board->hits[i][j] = HS_NONE;
         }
     }
+
+    memset(board->sunk, 0, sizeof board->sunk);
 }
 
 static char ourboard_char(struct our_board* board, int r, int c) {
@@ -99,4 +119,212 @@ void their_board_print(struct their_board* board) {
         }
         putchar('\n');
     }
+}
+
+static int has_ship(struct our_board* board, int r, int c) {
+    if (r >= BOARD_SIZE || c >= BOARD_SIZE || r < 0 || c < 0)
+        return 0;
+    
+    if (board->ships[r][c] != SHIP_NONE)
+        return 1;
+
+    return 0;
+}
+
+int ship_obstructed(struct our_board* board, int r, int c, int dir, int size) {
+    int cur_row = r, cur_col = c;
+    
+    for (int i = 0; i < size; i++) {
+        if (cur_row >= BOARD_SIZE || cur_col >= BOARD_SIZE)
+            return 1;
+
+        if (board->ships[cur_row][cur_col] != SHIP_NONE)
+            return 1;
+
+        // Check four neighboring squares to make sure there isn't a ship there either.
+        if (has_ship(board, cur_row - 1, cur_col)
+            || has_ship(board, cur_row + 1, cur_col)
+            || has_ship(board, cur_row, cur_col - 1)
+            || has_ship(board, cur_row, cur_col + 1))
+            return 1;
+
+        if (dir)
+            cur_row++;
+        else
+            cur_col++;
+    }
+    
+    return 0;
+}
+
+void place_ship(struct our_board* board, enum ship ship, int r, int c, int dir, int size) {
+    board->placements[ship] = (struct placed_ship){
+        .row = r,
+        .col = c,
+        .dir = dir,
+        .size = size,
+        .count = size
+    };
+
+    board->ship_count++;
+    
+    for (int i = 0; i < size; i++) {
+        assert(board->ships[r][c] == SHIP_NONE);
+
+        board->ships[r][c] = ship;
+
+        if (dir)
+            r++;
+        else
+            c++;
+    }
+}
+
+static void place_ship_random(struct our_board* board, enum ship ship, int size, struct rng* rng) {
+    TRACE_SCOPE("place_ship_random");
+
+    int obstructed_table[BOARD_SIZE][BOARD_SIZE][2];
+    int unobstructed_count = 0;
+
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            for (int k = 0; k < 2; k++) {
+                int obstructed = ship_obstructed(board, i, j, k, size);
+                obstructed_table[i][j][k] = obstructed;
+
+                if (!obstructed) {
+                    unobstructed_count++;
+                }
+            }
+        }
+    }
+
+    int idx = (int)rng_range(rng, unobstructed_count);
+    int counter = 0;
+
+    int r = 0, c = 0, dir = 0;
+    int placed = 0;
+
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            for (int k = 0; k < 2; k++) {
+                if (!obstructed_table[i][j][k] && idx == counter++) {
+                    placed = 1;
+
+                    r = i;
+                    c = j;
+                    dir = k;
+                }
+            }
+        }
+    }
+
+    // Only read by the assert, which builds with NDEBUG leave out.
+    (void)placed;
+    assert(placed);
+    place_ship(board, ship, r, c, dir, size);
+}
+
+void board_init_random(struct our_board* board, struct rng* rng) {
+    TRACE_SCOPE("board_init_random");
+
+    ourboard_init(board);
+    place_ship_random(board, AIRCRAFT_CARRIER, 5, rng);
+    place_ship_random(board, BATTLESHIP, 4, rng);
+    place_ship_random(board, CRUISER, 3, rng);
+    place_ship_random(board, SUBMARINE, 3, rng);
+    place_ship_random(board, DESTROYER, 2, rng);
+}
+
+void fleet_pack(struct our_board* board, struct fleet* fleet) {
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        struct placed_ship* placed = &board->placements[ship];
+        fleet->ships[ship - 1] = (struct packed_ship){
+            .row = (u8)placed->row,
+            .col = (u8)placed->col,
+            .dir = (u8)placed->dir
+        };
+    }
+}
+
+int fleet_unpack(const struct fleet* fleet, struct our_board* board) {
+    ourboard_init(board);
+
+    if (fleet_validate(fleet))
+        return -1;
+
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        const struct packed_ship* packed = &fleet->ships[ship - 1];
+        place_ship(board, (enum ship)ship, packed->row, packed->col, packed->dir, ship_size((enum ship)ship));
+    }
+
+    return 0;
+}
+
+// The board as a bit string, square (r, c) at bit r * BOARD_SIZE + c.
+typedef unsigned __int128 bitboard;
+
+#define BIT(n) ((bitboard)1 << (n))
+#define ALL_SQUARES (BIT(BOARD_SIZE * BOARD_SIZE) - 1)
+#define FIRST_COLUMN (BIT(0) | BIT(10) | BIT(20) | BIT(30) | BIT(40) | BIT(50) | BIT(60) | BIT(70) | BIT(80) | BIT(90))
+#define LAST_COLUMN (FIRST_COLUMN << (BOARD_SIZE - 1))
+
+// A ship plus every square it would touch. Sideways shifts would wrap into the next row, so
+// those drop whatever lands in the wrong column.
+static bitboard with_neighbors(bitboard ship) {
+    return ship
+        | ((ship << 1) & ~FIRST_COLUMN)
+        | ((ship >> 1) & ~LAST_COLUMN)
+        | ((ship << BOARD_SIZE) & ALL_SQUARES)
+        | (ship >> BOARD_SIZE);
+}
+
+int fleet_validate(const struct fleet* fleet) {
+    static const u8 sizes[SHIP_COUNT] = { 0, 5, 4, 3, 3, 2 };
+    // Ship shapes lying at (0, 0), indexed by direction and size.
+    static const bitboard shapes[2][6] = {
+        { 0, 0x1, 0x3, 0x7, 0xF, 0x1F },
+        {
+            0,
+            FIRST_COLUMN & (BIT(10) - 1),
+            FIRST_COLUMN & (BIT(20) - 1),
+            FIRST_COLUMN & (BIT(30) - 1),
+            FIRST_COLUMN & (BIT(40) - 1),
+            FIRST_COLUMN & (BIT(50) - 1)
+        }
+    };
+
+    bitboard occupied = 0;
+    unsigned bad = 0;
+
+    // No early exits: every fleet costs the same handful of shifts and masks.
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        const struct packed_ship* packed = &fleet->ships[ship - 1];
+        unsigned size = sizes[ship];
+        unsigned row = packed->row, col = packed->col, dir = packed->dir & 1;
+        // Direction is random in real fleets, so pick with masks rather than a branch.
+        unsigned along = (row & -dir) | (col & (dir - 1));
+
+        unsigned ok = (row < BOARD_SIZE) & (col < BOARD_SIZE) & (packed->dir <= 1) & (along + size <= BOARD_SIZE);
+        bad |= !ok;
+
+        // Anything off the board becomes a ship at (0, 0), so the shift stays in range. The fleet
+        // is already rejected by then.
+        unsigned square = (row * BOARD_SIZE + col) & -ok;
+        bitboard mask = shapes[dir][size] << square;
+
+        bad |= (with_neighbors(mask) & occupied) != 0;
+        occupied |= mask;
+    }
+
+    return -(int)bad;
+}
+
+int fleet_validate_batch(const struct fleet* fleets, int count, i8* results) {
+    int legal = 0;
+    for (int i = 0; i < count; i++) {
+        results[i] = (i8)fleet_validate(&fleets[i]);
+        legal += results[i] + 1;
+    }
+    return legal;
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef _BOARD_H
 #define _BOARD_H
 
+#include "util.h"
+
 #define BOARD_SIZE 10
 
 enum hit_state {
@@ -22,6 +24,7 @@ enum ship {
 };
 
 const char* ship_name(enum ship ship);
+int ship_size(enum ship ship);
 
 struct placed_ship {
     int row, col;
@@ -40,11 +43,40 @@ struct our_board {
 
 struct their_board {
     enum hit_state hits[BOARD_SIZE][BOARD_SIZE];
+    // Ships we've sunk, indexed by ship. size is 0 while the ship is still afloat.
+    struct placed_ship sunk[SHIP_COUNT];
+};
+
+// A fleet packed down to where each ship starts and which way it faces. ships[0] is the
+// aircraft carrier, ships[SHIP_COUNT - 2] the destroyer.
+struct packed_ship {
+    u8 row, col, dir;
+};
+
+struct fleet {
+    struct packed_ship ships[SHIP_COUNT - 1];
 };
 
+void fleet_pack(struct our_board* board, struct fleet* fleet);
+// Places a packed fleet on a cleared board. Returns -1 if the fleet isn't legal.
+int fleet_unpack(const struct fleet* fleet, struct our_board* board);
+
+// Checks that every ship is on the board, facing a real direction, and neither overlaps nor sits
+// next to another, without placing anything. Any bytes at all are safe to pass in, so this is
+// what untrusted fleets go through. Returns 0 if the fleet is legal, -1 if not.
+int fleet_validate(const struct fleet* fleet);
+// fleet_validate for many fleets: results[i] is 0 or -1 for fleets[i]. Returns how many are legal.
+int fleet_validate_batch(const struct fleet* fleets, int count, i8* results);
+
 void ourboard_init(struct our_board* board);
 void their_board_init(struct their_board* board);
 
+// 1 if a ship can't go here: it would leave the board, overlap a ship or touch one.
+int ship_obstructed(struct our_board* board, int r, int c, int dir, int size);
+void place_ship(struct our_board* board, enum ship ship, int r, int c, int dir, int size);
+// Clears the board and places every ship at random.
+void board_init_random(struct our_board* board, struct rng* rng);
+
 void ourboard_print(struct our_board* board);
 void their_board_print(struct their_board* board);
 
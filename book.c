@@ -0,0 +1,349 @@
+#include "book.h"
+#include "ai.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File layout, in native byte order: magic, version, entry count, depth, then the entries sorted
+// by key so lookups can binary search the mapped file directly.
+#define BOOK_MAGIC "BSOB"
+#define BOOK_VERSION 1
+#define BOOK_HEADER_LENGTH 16
+#define SYMMETRIES 8
+
+// Where (r, c) ends up under symmetry t: bit 0 mirrors the columns, bit 1 the rows, and bit 2
+// then swaps rows and columns.
+static void transform(int t, int r, int c, int* tr, int* tc) {
+    if (t & 1)
+        c = BOARD_SIZE - 1 - c;
+    if (t & 2)
+        r = BOARD_SIZE - 1 - r;
+    *tr = t & 4 ? c : r;
+    *tc = t & 4 ? r : c;
+}
+
+static void untransform(int t, int r, int c, int* or, int* oc) {
+    if (t & 4) {
+        int swap = r;
+        r = c;
+        c = swap;
+    }
+    *or = t & 2 ? BOARD_SIZE - 1 - r : r;
+    *oc = t & 1 ? BOARD_SIZE - 1 - c : c;
+}
+
+static void set_square(u64 words[2], int r, int c) {
+    int square = r * BOARD_SIZE + c;
+    words[square / 64] |= 1ull << (square % 64);
+}
+
+static int key_compare(const struct book_key* a, const struct book_key* b) {
+    const u64 wa[4] = { a->hits[1], a->hits[0], a->misses[1], a->misses[0] };
+    const u64 wb[4] = { b->hits[1], b->hits[0], b->misses[1], b->misses[0] };
+    for (int i = 0; i < 4; i++) {
+        if (wa[i] != wb[i])
+            return wa[i] < wb[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static int entry_compare(const void* a, const void* b) {
+    return key_compare(&((const struct book_entry*)a)->key, &((const struct book_entry*)b)->key);
+}
+
+static int key_sort_compare(const void* a, const void* b) {
+    return key_compare(a, b);
+}
+
+// Finds the canonical form of the board and sets a bit in `symmetries` for every symmetry that
+// turns the board into it. Returns -1 for boards a book can't hold: ones with sunk ships or more
+// than max_shots shots.
+static int canonicalize(const struct their_board* board, int max_shots, struct book_key* key, int* symmetries) {
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        if (board->sunk[ship].size)
+            return -1;
+    }
+
+    int shots[BOARD_SIZE * BOARD_SIZE];
+    int count = 0;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            if (board->hits[i][j] != HS_NONE)
+                shots[count++] = i * BOARD_SIZE + j;
+        }
+    }
+
+    if (count > max_shots)
+        return -1;
+
+    for (int t = 0; t < SYMMETRIES; t++) {
+        struct book_key candidate = {0};
+        for (int i = 0; i < count; i++) {
+            int r = shots[i] / BOARD_SIZE, c = shots[i] % BOARD_SIZE, tr, tc;
+            transform(t, r, c, &tr, &tc);
+            set_square(board->hits[r][c] == HIT ? candidate.hits : candidate.misses, tr, tc);
+        }
+
+        int cmp = t == 0 ? -1 : key_compare(&candidate, key);
+        if (cmp < 0) {
+            *key = candidate;
+            *symmetries = 1 << t;
+        } else if (cmp == 0) {
+            *symmetries |= 1 << t;
+        }
+    }
+
+    return 0;
+}
+
+static void board_from_key(const struct book_key* key, struct their_board* board) {
+    their_board_init(board);
+    for (int square = 0; square < BOARD_SIZE * BOARD_SIZE; square++) {
+        u64 bit = 1ull << (square % 64);
+        if (key->hits[square / 64] & bit)
+            board->hits[square / BOARD_SIZE][square % BOARD_SIZE] = HIT;
+        else if (key->misses[square / 64] & bit)
+            board->hits[square / BOARD_SIZE][square % BOARD_SIZE] = MISS;
+    }
+}
+
+// Checks everything a lookup trusts: the shot is on the board and not already taken, the key only
+// uses squares that exist, and the keys are strictly increasing so the binary search works.
+static int entries_valid(const struct book_entry* entries, u32 count) {
+    const u64 board_mask[2] = { ~0ull, (1ull << (BOARD_SIZE * BOARD_SIZE - 64)) - 1 };
+
+    for (u32 i = 0; i < count; i++) {
+        const struct book_entry* entry = &entries[i];
+        if (entry->row >= BOARD_SIZE || entry->col >= BOARD_SIZE)
+            return 0;
+
+        u64 shot[2] = {0};
+        set_square(shot, entry->row, entry->col);
+        for (int w = 0; w < 2; w++) {
+            u64 used = entry->key.hits[w] | entry->key.misses[w];
+            if ((entry->key.hits[w] & entry->key.misses[w]) || (used & ~board_mask[w]) || (used & shot[w]))
+                return 0;
+        }
+
+        if (i > 0 && key_compare(&entries[i - 1].key, &entry->key) >= 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+int book_open(struct opening_book* book, const char* path) {
+    memset(book, 0, sizeof *book);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("book file error");
+        return -1;
+    }
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= BOOK_HEADER_LENGTH)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "%s is not a valid book file\n", path);
+        return -1;
+    }
+
+    const u8* header = map;
+    u32 version, count;
+    memcpy(&version, header + 4, 4);
+    memcpy(&count, header + 8, 4);
+    memcpy(&book->depth, header + 12, 4);
+    if (memcmp(header, BOOK_MAGIC, 4) != 0 || version != BOOK_VERSION
+        || (size_t)st.st_size != BOOK_HEADER_LENGTH + (size_t)count * sizeof(struct book_entry)
+        || !entries_valid((const struct book_entry*)(header + BOOK_HEADER_LENGTH), count)) {
+        fprintf(stderr, "%s is not a valid book file\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    book->map = map;
+    book->map_size = st.st_size;
+    book->entries = (const struct book_entry*)(header + BOOK_HEADER_LENGTH);
+    book->count = count;
+    return 0;
+}
+
+void book_close(struct opening_book* book) {
+    if (book->map)
+        munmap(book->map, book->map_size);
+    memset(book, 0, sizeof *book);
+}
+
+int book_lookup(const struct opening_book* book, struct their_board* board, struct rng* rng, int* r, int* c) {
+    struct book_key key;
+    int symmetries;
+    // Most of a game is past the book, so those positions are turned away before any work.
+    if (canonicalize(board, (int)book->depth - 1, &key, &symmetries))
+        return -1;
+
+    u32 lo = 0, hi = book->count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        int cmp = key_compare(&book->entries[mid].key, &key);
+        if (cmp == 0) {
+            // Any symmetry that gives the canonical board maps the stored shot to an equally good one.
+            int pick = rng ? (int)rng_range(rng, __builtin_popcount(symmetries)) : 0;
+            int t = 0;
+            for (; t < SYMMETRIES; t++) {
+                if ((symmetries & (1 << t)) && pick-- == 0)
+                    break;
+            }
+
+            untransform(t, book->entries[mid].row, book->entries[mid].col, r, c);
+            if (*r < 0 || *r >= BOARD_SIZE || *c < 0 || *c >= BOARD_SIZE)
+                return -1;
+            return board->hits[*r][*c] == HS_NONE ? 0 : -1;
+        }
+
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return -1;
+}
+
+struct book_job {
+    const struct book_key* positions;
+    struct book_entry* entries;
+    u32 count;
+    _Atomic u32 next;
+};
+
+static void* worker(void* arg) {
+    struct book_job* job = arg;
+    u32 i;
+
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+        struct their_board board;
+        board_from_key(&job->positions[i], &board);
+
+        int r, c;
+        struct book_entry* entry = &job->entries[i];
+        memset(entry, 0, sizeof *entry);
+        entry->key = job->positions[i];
+        if (ai_choose_shot(&board, NULL, NULL, &r, &c) == 0) {
+            entry->row = (u8)r;
+            entry->col = (u8)c;
+        } else {
+            entry->row = entry->col = 0xFF;
+        }
+    }
+
+    return NULL;
+}
+
+int book_generate(const char* path, int depth, int threads) {
+    struct book_key* positions = malloc(sizeof(struct book_key));
+    struct book_entry* entries = NULL;
+    u32 position_count = 1, entry_count = 0;
+    int status = -1;
+
+    if (!positions)
+        goto done;
+    memset(positions, 0, sizeof *positions);
+
+    threads = threads < 1 ? 1 : threads;
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    if (!tids)
+        goto done;
+
+    // One ply at a time: find the AI's shot in every position, then both ways it can go.
+    for (int ply = 0; ply < depth && position_count > 0; ply++) {
+        struct book_entry* grown = realloc(entries, (entry_count + position_count) * sizeof(struct book_entry));
+        if (!grown)
+            goto done_threads;
+        entries = grown;
+
+        struct book_job job = { .positions = positions, .entries = &entries[entry_count], .count = position_count };
+        atomic_init(&job.next, 0);
+        for (int i = 0; i < threads; i++)
+            pthread_create(&tids[i], NULL, worker, &job);
+        for (int i = 0; i < threads; i++)
+            pthread_join(tids[i], NULL);
+
+        struct book_key* next = malloc(2 * (size_t)position_count * sizeof(struct book_key));
+        if (!next)
+            goto done_threads;
+
+        u32 next_count = 0;
+        for (u32 i = 0; i < position_count; i++) {
+            struct book_entry* entry = &entries[entry_count + i];
+            if (entry->row == 0xFF || ply + 1 == depth)
+                continue;
+
+            for (int outcome = 0; outcome < 2; outcome++) {
+                struct their_board board;
+                int symmetries;
+                board_from_key(&positions[i], &board);
+                board.hits[entry->row][entry->col] = outcome ? HIT : MISS;
+                canonicalize(&board, BOARD_SIZE * BOARD_SIZE, &next[next_count++], &symmetries);
+            }
+        }
+
+        // Different histories often reach the same position, keep one of each.
+        qsort(next, next_count, sizeof(struct book_key), key_sort_compare);
+        u32 unique = 0;
+        for (u32 i = 0; i < next_count; i++) {
+            if (unique == 0 || key_compare(&next[unique - 1], &next[i]) != 0)
+                next[unique++] = next[i];
+        }
+
+        // Positions the AI has nothing to say about aren't worth keeping.
+        u32 kept = 0;
+        for (u32 i = 0; i < position_count; i++) {
+            if (entries[entry_count + i].row != 0xFF)
+                entries[entry_count + kept++] = entries[entry_count + i];
+        }
+        entry_count += kept;
+
+        free(positions);
+        positions = next;
+        position_count = unique;
+        fprintf(stderr, "ply %i: %u positions\n", ply + 1, kept);
+    }
+
+    // Every ply has a different number of shots, so no key appears twice.
+    qsort(entries, entry_count, sizeof(struct book_entry), entry_compare);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        perror("book file error");
+        goto done_threads;
+    }
+
+    u32 header[4] = { 0, BOOK_VERSION, entry_count, (u32)depth };
+    memcpy(header, BOOK_MAGIC, 4);
+    status = fwrite(header, sizeof header, 1, file) != 1
+        || fwrite(entries, sizeof(struct book_entry), entry_count, file) != entry_count;
+    status |= fclose(file) != 0;
+    if (status) {
+        perror("book file write error");
+        status = -1;
+    } else {
+        printf("%u positions, %zu bytes\n", entry_count, BOOK_HEADER_LENGTH + entry_count * sizeof(struct book_entry));
+    }
+
+done_threads:
+    free(tids);
+done:
+    free(entries);
+    free(positions);
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef _BOOK_H
+#define _BOOK_H
+
+#include "board.h"
+#include <stddef.h>
+
+// A position: which squares were hits and which were misses, bit (row * 10 + col) of each pair of
+// words. Positions in a book are in canonical form, the smallest of the board's 8 rotations and
+// reflections, so one entry covers every symmetric copy.
+struct book_key {
+    u64 hits[2];
+    u64 misses[2];
+};
+
+struct book_entry {
+    struct book_key key;
+    // The AI's shot in the canonical position.
+    u8 row, col;
+    u8 reserved[6];
+};
+
+// An opening book mapped read only, so every process using the same file shares one copy.
+struct opening_book {
+    const struct book_entry* entries;
+    u32 count;
+    // Most shots in any position in the book.
+    u32 depth;
+    void* map;
+    size_t map_size;
+};
+
+// Maps a book. Returns -1 on failure.
+int book_open(struct opening_book* book, const char* path);
+void book_close(struct opening_book* book);
+
+// Looks the position up, turning the stored shot back to this board's orientation. Positions
+// that look the same under several symmetries (like the empty board) get one of the matching
+// shots at random if rng is given. Returns -1 if the position isn't in the book, which is always
+// the case once a ship has sunk.
+int book_lookup(const struct opening_book* book, struct their_board* board, struct rng* rng, int* r, int* c);
+
+// Plays the AI against every hit/miss outcome of its first `depth` shots and writes each
+// position it reaches, with the shot it takes there, to a sorted book. Returns -1 on failure.
+int book_generate(const char* path, int depth, int threads);
+
+#endif
\ No newline at end of file
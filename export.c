@@ -0,0 +1,223 @@
+#include "export.h"
+#include "sim.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Samples buffered per thread between writes.
+#define BUFFER_SAMPLES 16384
+// Games a thread takes at a time.
+#define GAME_BATCH 64
+
+struct export_job {
+    const char* dir;
+    struct export_options* options;
+    _Atomic int next_game;
+    _Atomic int next_shard;
+    _Atomic u64 samples;
+    _Atomic int failed;
+};
+
+// One per thread. Samples are built straight into buf, and the board planes are kept up to date
+// shot by shot instead of being rebuilt from the board each time.
+struct export_writer {
+    struct export_job* job;
+    int fd;
+    int shard_used;
+    u8* buf;
+    int used;
+
+    const struct our_board* fleet;
+    u8 planes[3][16];
+    u8 remaining;
+    u8 shot_index;
+};
+
+static int write_all(int fd, const u8* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int open_shard(struct export_writer* writer) {
+    char path[4096];
+    snprintf(path, sizeof path, "%s/shard-%05d.bin", writer->job->dir, atomic_fetch_add(&writer->job->next_shard, 1));
+
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        perror("export error");
+        return -1;
+    }
+
+    u8 header[EXPORT_HEADER_LENGTH] = { 'B', 'S', 'T', 'D', EXPORT_VERSION, EXPORT_SAMPLE_LENGTH };
+    writer->shard_used = 0;
+    if (write_all(writer->fd, header, sizeof header)) {
+        perror("export error");
+        return -1;
+    }
+    return 0;
+}
+
+static int flush(struct export_writer* writer) {
+    if (writer->used == 0)
+        return 0;
+
+    // Opened on demand, so a run that ends right on a shard boundary doesn't leave an empty one.
+    if (writer->fd < 0 && open_shard(writer))
+        return -1;
+
+    if (write_all(writer->fd, writer->buf, (size_t)writer->used * EXPORT_SAMPLE_LENGTH)) {
+        perror("export error");
+        return -1;
+    }
+
+    atomic_fetch_add(&writer->job->samples, writer->used);
+    writer->shard_used += writer->used;
+    writer->used = 0;
+    return 0;
+}
+
+static int close_shard(struct export_writer* writer) {
+    // Samples still buffered may not have a shard yet, flush() opens one for them.
+    int status = flush(writer);
+    if (writer->fd < 0)
+        return status;
+
+    if (close(writer->fd) && status == 0) {
+        perror("export error");
+        status = -1;
+    }
+    writer->fd = -1;
+    writer->shard_used = 0;
+    return status;
+}
+
+static void set_bit(u8* plane, int r, int c) {
+    int bit = r * BOARD_SIZE + c;
+    plane[bit / 8] |= 1 << (bit % 8);
+}
+
+static void observe(void* ctx, const struct their_board* view, int r, int c, enum hit_state result, enum ship sunk) {
+    struct export_writer* writer = ctx;
+    (void)view;
+
+    if (atomic_load_explicit(&writer->job->failed, memory_order_relaxed))
+        return;
+
+    u8* sample = &writer->buf[(size_t)writer->used * EXPORT_SAMPLE_LENGTH];
+    memcpy(sample, writer->planes, sizeof writer->planes);
+    sample[48] = writer->remaining;
+    sample[49] = (u8)(r * BOARD_SIZE + c);
+    sample[50] = (u8)result;
+    sample[51] = (u8)sunk;
+    sample[52] = writer->shot_index++;
+    memset(sample + 53, 0, EXPORT_SAMPLE_LENGTH - 53);
+
+    set_bit(writer->planes[result == HIT ? 0 : 1], r, c);
+    if (sunk != SHIP_NONE) {
+        const struct placed_ship* ship = &writer->fleet->placements[sunk];
+        for (int i = 0; i < ship->size; i++)
+            set_bit(writer->planes[2], ship->row + (ship->dir ? i : 0), ship->col + (ship->dir ? 0 : i));
+        writer->remaining &= ~(1 << sunk);
+    }
+
+    // Shards only roll over between flushes, so keep flushes from straddling the boundary.
+    int shard_room = writer->job->options->shard_samples - writer->shard_used;
+    if (++writer->used < BUFFER_SAMPLES && writer->used < shard_room)
+        return;
+
+    if (flush(writer) || (writer->shard_used >= writer->job->options->shard_samples
+                             && close_shard(writer)))
+        atomic_store(&writer->job->failed, 1);
+}
+
+static void* worker(void* arg) {
+    struct export_job* job = arg;
+    struct export_options* options = job->options;
+    struct export_writer writer = { .job = job, .fd = -1, .buf = malloc((size_t)BUFFER_SAMPLES * EXPORT_SAMPLE_LENGTH) };
+
+    if (!writer.buf) {
+        atomic_store(&job->failed, 1);
+        return NULL;
+    }
+
+    int first;
+    while (!atomic_load(&job->failed) && (first = atomic_fetch_add(&job->next_game, GAME_BATCH)) < options->games) {
+        int last = first + GAME_BATCH < options->games ? first + GAME_BATCH : options->games;
+
+        for (int g = first; g < last; g++) {
+            // Placing and shooting draw from separate streams, the same way tournaments and the
+            // benchmark seed their games.
+            struct rng place_rng, shoot_rng;
+            struct our_board fleet;
+            rng_seed(&place_rng, sim_game_seed(options->seed, g, 0));
+            rng_seed(&shoot_rng, sim_game_seed(options->seed, g, 1));
+            ourboard_init(&fleet);
+            options->strategy->place(&fleet, &place_rng);
+
+            writer.fleet = &fleet;
+            memset(writer.planes, 0, sizeof writer.planes);
+            writer.remaining = 0;
+            for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++)
+                writer.remaining |= 1 << ship;
+            writer.shot_index = 0;
+
+            if (fleet.ship_count != SHIP_COUNT - 1 || sim_play(&fleet, options->strategy, &shoot_rng, observe, &writer) < 0) {
+                fprintf(stderr, "%s didn't play a legal game\n", options->strategy->name);
+                atomic_store(&job->failed, 1);
+                break;
+            }
+        }
+    }
+
+    if (close_shard(&writer))
+        atomic_store(&job->failed, 1);
+    free(writer.buf);
+    return NULL;
+}
+
+int export_samples(const char* dir, struct export_options* options) {
+    if (mkdir(dir, 0755) && errno != EEXIST) {
+        perror("export error");
+        return -1;
+    }
+
+    struct export_job job = { .dir = dir, .options = options };
+    atomic_init(&job.next_game, 0);
+    atomic_init(&job.next_shard, 0);
+    atomic_init(&job.samples, 0);
+    atomic_init(&job.failed, 0);
+
+    int threads = options->threads < 1 ? 1 : options->threads;
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    u64 start = time_ms();
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, worker, &job);
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    free(tids);
+
+    if (atomic_load(&job.failed))
+        return -1;
+
+    double seconds = (time_ms() - start) / 1000.0;
+    u64 samples = atomic_load(&job.samples);
+    printf("%i games, %llu samples in %i shards, %.1fs (%.0f samples/s)\n", options->games,
+        (unsigned long long)samples, atomic_load(&job.next_shard), seconds, samples / (seconds > 0 ? seconds : 1e-3));
+    return 0;
+}
\ No newline at end of file
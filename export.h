@@ -0,0 +1,38 @@
+#ifndef _EXPORT_H
+#define _EXPORT_H
+
+#include "strategy.h"
+
+// Shards are named shard-00000.bin, shard-00001.bin, ... and each starts with a 16 byte header:
+// magic "BSTD", a version byte, the sample length in bytes, then zeros. After that come fixed
+// width samples, one per shot:
+//
+//   bytes  0-15  squares that were hits, bit (row * 10 + col) of the little endian bit string
+//   bytes 16-31  squares that were misses, same layout
+//   bytes 32-47  squares of ships that were already sunk, same layout
+//   byte  48     ships still afloat before the shot, bit (1 << ship)
+//   byte  49     the shot, row * 10 + col
+//   byte  50     what it did, HIT or MISS
+//   byte  51     which ship it sank, SHIP_NONE if none
+//   byte  52     how many shots came before it in the game
+//   bytes 53-63  zero
+#define EXPORT_MAGIC "BSTD"
+#define EXPORT_VERSION 1
+#define EXPORT_HEADER_LENGTH 16
+#define EXPORT_SAMPLE_LENGTH 64
+
+struct export_options {
+    int games;
+    int threads;
+    u64 seed;
+    // Whose shots to record. It also places the fleets it shoots at.
+    const struct strategy* strategy;
+    // Samples per shard before starting the next one.
+    int shard_samples;
+};
+
+// Plays simulated games on several threads and streams every shot into shards in dir, creating
+// it if needed. Returns -1 on failure.
+int export_samples(const char* dir, struct export_options* options);
+
+#endif
\ No newline at end of file
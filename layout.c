@@ -0,0 +1,145 @@
+#include "layout.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Pool file layout: magic, version byte, fleet count (4 bytes, big endian), then each fleet as
+// row, col, dir for every ship followed by its score in hundredths of a shot (2 bytes, big endian).
+#define LAYOUT_MAGIC "BSPL"
+#define LAYOUT_VERSION 1
+#define LAYOUT_RECORD_LENGTH (3 * (SHIP_COUNT - 1) + 2)
+
+int layout_pool_load(struct layout_pool* pool, const char* path) {
+    memset(pool, 0, sizeof *pool);
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror("layout file error");
+        return -1;
+    }
+
+    u8 header[9];
+    if (fread(header, 1, sizeof header, file) != sizeof header
+        || memcmp(header, LAYOUT_MAGIC, 4) != 0 || header[4] != LAYOUT_VERSION)
+        goto invalid;
+
+    u32 count = ((u32)header[5] << 24) | ((u32)header[6] << 16) | ((u32)header[7] << 8) | header[8];
+    if (count == 0 || count > 1000000)
+        goto invalid;
+
+    pool->count = (int)count;
+    pool->fleets = calloc(count, sizeof(struct fleet));
+    pool->scores = calloc(count, sizeof(float));
+    if (!pool->fleets || !pool->scores)
+        goto invalid;
+
+    for (u32 i = 0; i < count; i++) {
+        u8 record[LAYOUT_RECORD_LENGTH];
+        if (fread(record, 1, sizeof record, file) != sizeof record)
+            goto invalid;
+
+        for (int s = 0; s < SHIP_COUNT - 1; s++) {
+            pool->fleets[i].ships[s] = (struct packed_ship){
+                .row = record[3 * s],
+                .col = record[3 * s + 1],
+                .dir = record[3 * s + 2]
+            };
+        }
+        pool->scores[i] = ((record[LAYOUT_RECORD_LENGTH - 2] << 8) | record[LAYOUT_RECORD_LENGTH - 1]) / 100.0f;
+    }
+
+    // The file could come from anywhere, so make sure every fleet is actually legal.
+    i8* results = malloc(count);
+    int legal = results ? fleet_validate_batch(pool->fleets, (int)count, results) : -1;
+    free(results);
+    if (legal != (int)count)
+        goto invalid;
+
+    fclose(file);
+    return 0;
+
+invalid:
+    fprintf(stderr, "%s is not a valid layout file\n", path);
+    fclose(file);
+    layout_pool_free(pool);
+    return -1;
+}
+
+int layout_pool_save(struct layout_pool* pool, const char* path) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof tmp_path, "%s.tmp", path);
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) {
+        perror("layout file error");
+        return -1;
+    }
+
+    u32 count = (u32)pool->count;
+    u8 header[9] = { 'B', 'S', 'P', 'L', LAYOUT_VERSION,
+        (u8)(count >> 24), (u8)(count >> 16), (u8)(count >> 8), (u8)count };
+
+    int status = fwrite(header, 1, sizeof header, file) != sizeof header;
+
+    for (int i = 0; i < pool->count; i++) {
+        u8 record[LAYOUT_RECORD_LENGTH];
+        for (int s = 0; s < SHIP_COUNT - 1; s++) {
+            record[3 * s] = pool->fleets[i].ships[s].row;
+            record[3 * s + 1] = pool->fleets[i].ships[s].col;
+            record[3 * s + 2] = pool->fleets[i].ships[s].dir;
+        }
+
+        u16 score = (u16)(pool->scores[i] * 100);
+        record[LAYOUT_RECORD_LENGTH - 2] = (u8)(score >> 8);
+        record[LAYOUT_RECORD_LENGTH - 1] = (u8)(score & 0xFF);
+
+        status |= fwrite(record, 1, sizeof record, file) != sizeof record;
+    }
+
+    status |= fclose(file) != 0;
+
+    // Write then rename, so a crash never leaves a half written pool behind.
+    if (status || rename(tmp_path, path) < 0) {
+        perror("layout write error");
+        remove(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+void layout_pool_free(struct layout_pool* pool) {
+    free(pool->fleets);
+    free(pool->scores);
+    memset(pool, 0, sizeof *pool);
+}
+
+// Applies one of the 8 symmetries of the board. Mirroring or turning a fleet doesn't make it any
+// easier to find, so this stretches the pool eightfold for free.
+static void transform_fleet(struct fleet* fleet, int symmetry) {
+    for (int s = 0; s < SHIP_COUNT - 1; s++) {
+        struct packed_ship* ship = &fleet->ships[s];
+        int size = ship_size((enum ship)(s + 1));
+
+        if (symmetry & 1) {
+            u8 row = ship->row;
+            ship->row = ship->col;
+            ship->col = row;
+            ship->dir = !ship->dir;
+        }
+
+        if (symmetry & 2)
+            ship->row = (u8)(BOARD_SIZE - 1 - ship->row - (ship->dir ? size - 1 : 0));
+
+        if (symmetry & 4)
+            ship->col = (u8)(BOARD_SIZE - 1 - ship->col - (ship->dir ? 0 : size - 1));
+    }
+}
+
+void layout_pool_sample(struct layout_pool* pool, struct rng* rng, struct our_board* board) {
+    struct fleet fleet = pool->fleets[rng_range(rng, pool->count)];
+    transform_fleet(&fleet, (int)rng_range(rng, 8));
+
+    // Every fleet was checked when the pool was loaded, and symmetries keep it legal.
+    fleet_unpack(&fleet, board);
+}
\ No newline at end of file
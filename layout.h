@@ -0,0 +1,22 @@
+#ifndef _LAYOUT_H
+#define _LAYOUT_H
+
+#include "board.h"
+
+// Precomputed fleets that are hard to find, written by `battleship optimize`.
+struct layout_pool {
+    int count;
+    struct fleet* fleets;
+    // Average shots the AI needed against each fleet when it was picked.
+    float* scores;
+};
+
+// Returns -1 if the file can't be read or holds an illegal fleet.
+int layout_pool_load(struct layout_pool* pool, const char* path);
+int layout_pool_save(struct layout_pool* pool, const char* path);
+void layout_pool_free(struct layout_pool* pool);
+
+// Places a random fleet from the pool on the board.
+void layout_pool_sample(struct layout_pool* pool, struct rng* rng, struct our_board* board);
+
+#endif
\ No newline at end of file
@@ -1,21 +1,94 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "ai.h"
+#include "analyze.h"
 #include "board.h"
+#include "bench.h"
+#include "book.h"
+#include "export.h"
 #include "packet.h"
 #include "player.h"
+#include "rating.h"
+#include "replay.h"
+#include "script.h"
+#include "trace.h"
 #include "network.h"
+#include "optimize.h"
+#include "opponent.h"
+#include "strategy.h"
+#include "tournament.h"
+#include "transport.h"
+
+// How long to wait for packets the other side sends without waiting on its player.
+#define REPLY_TIMEOUT_MS (10 * 1000)
+// How long to wait for the other player to place their ships or start the game.
+#define IDLE_TIMEOUT_MS (10 * 60 * 1000)
+// How long the client keeps trying to connect, and how long it gives each address before it also
+// tries the next one.
+#define CONNECT_TIMEOUT_MS (10 * 1000)
+#define CONNECT_ATTEMPT_DELAY_MS 250
+#define CONNECT_MAX_ADDRESSES 16
+// Default time the other player gets for each move.
+#define TURN_TIMEOUT_MS (2 * 60 * 1000)
+
+// How many packets per second a client may send, and how many it may send at once.
+#define RATE_LIMIT_PER_SECOND 20
+#define RATE_LIMIT_BURST 40
+
+struct game_options {
+    enum game_mode mode;
+    // How long the other player gets to make a move. 0 waits forever.
+    int turn_timeout_ms;
+    // Replay file to append the game to, if any.
+    const char* record_path;
+    // Where we keep what we've learned about opponents' ship placements, if anywhere.
+    const char* opponents_path;
+    // Who we're playing, as far as we can tell.
+    char opponent[OPPONENT_NAME_LENGTH];
+    // Rating store to update with the result, if any, and who we are in it.
+    const char* ratings_path;
+    const char* name;
+    // Set on the client when the server records to the same rating store, so the game is only
+    // counted once.
+    int server_records_ratings;
+    // Hard to find fleets to pick from instead of random ones, if loaded.
+    struct layout_pool* pool;
+    // Plays for us without prompts or board redraws, NULL when a human is playing.
+    struct script* script;
+    // Packets per second a client may send the server, 0 for no limit.
+    int rate_limit;
+    // Newest protocol version to offer. 1 talks to servers from before the version was negotiated.
+    int protocol;
+    // Prints nothing at all, for the bot's side of a local game.
+    int quiet;
+};
 
 struct game_state {
     struct our_board board;
     struct their_board their_board;
     enum peer_type turn;
+    enum game_mode mode;
+    // How many of their ships are still afloat. In salvo mode this is how many shots they get.
+    int their_ship_count;
+    int turn_timeout_ms;
+    struct replay replay;
+    // What we know about where this opponent puts their ships, NULL if nothing.
+    struct placement_prior* prior;
+    struct script* script;
+    int quiet;
 };
 
 #define EXPECT_PACKET(conn, packet, pkttype, name) \
@@ -32,192 +105,518 @@ struct game_state {
         exit(1);                                \
     }
 
-static void play_game(struct connection* conn) {
-    struct game_state state;
+static int count_unshot(enum hit_state hits[BOARD_SIZE][BOARD_SIZE]) {
+    int count = 0;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            if (hits[i][j] == HS_NONE)
+                count++;
+        }
+    }
+    return count;
+}
+
+// How many shots a salvo fired by a player with ship_count ships afloat should contain.
+static int salvo_size(int ship_count, enum hit_state hits[BOARD_SIZE][BOARD_SIZE]) {
+    int unshot = count_unshot(hits);
+    return ship_count < unshot ? ship_count : unshot;
+}
+
+// Reads a square to shoot at from the player (or script). Squares in `pending` are treated as
+// already shot. A blank line takes the AI's suggestion.
+static void get_shot(struct connection* conn, struct game_state* state, struct pkt_move* pending, int pending_count, int* r, int* c) {
+    if (state->script) {
+        struct their_board board = state->their_board;
+        for (int i = 0; i < pending_count; i++)
+            board.hits[pending[i].row][pending[i].col] = MISS;
+
+        if (script_shoot(state->script, &board, r, c)) {
+            disconnectf(conn, "script error");
+            exit(1);
+        }
+        return;
+    }
+
+    while (1) {
+        int status = player_get_coord(r, c);
+        if (status < 0)
+            continue;
+
+        if (status == 1) {
+            // The AI doesn't know about the rest of the salvo, so let it see those as misses.
+            struct their_board board = state->their_board;
+            for (int i = 0; i < pending_count; i++)
+                board.hits[pending[i].row][pending[i].col] = MISS;
+
+            if (ai_choose_shot(&board, state->prior, NULL, r, c))
+                continue;
+
+            printf("Shooting at %c%i\n", *c + 'A', *r + 1);
+            return;
+        }
+
+        int duplicate = state->their_board.hits[*r][*c] != HS_NONE;
+        for (int i = 0; i < pending_count; i++) {
+            if (pending[i].row == *r && pending[i].col == *c)
+                duplicate = 1;
+        }
+
+        if (duplicate) {
+            printf("You've already shot at this square.\n");
+            continue;
+        }
+
+        return;
+    }
+}
+
+// Resolves one of their shots against our board. Returns the ship that was hit, if any.
+static enum ship resolve_shot(struct game_state* state, int r, int c, struct pkt_move_result* result) {
+    TRACE_SCOPE("resolve_shot");
+
+    *result = (struct pkt_move_result){0};
+
+    enum ship ship = state->board.ships[r][c];
+    if (ship != SHIP_NONE) {
+        result->result = NET_HIT;
+        state->board.hits[r][c] = HIT;
+        if (--state->board.placements[ship].count <= 0) {
+            struct placed_ship sunk = state->board.placements[ship];
+            result->result = NET_SINK;
+            result->ship_row = sunk.row;
+            result->ship_col = sunk.col;
+            result->ship_dir = sunk.dir;
+            result->ship_size = sunk.size;
+            result->ship_type = ship;
+
+            if (--state->board.ship_count <= 0) {
+                result->win = 1;
+            }
+        }
+    } else {
+        result->result = NET_MISS;
+        state->board.hits[r][c] = MISS;
+    }
+
+    replay_add_move(&state->replay, 0, r, c, result);
+
+    return ship;
+}
+
+// Records the result of one of our shots on their board.
+static void apply_result(struct game_state* state, int r, int c, struct pkt_move_result* result) {
+    TRACE_SCOPE("apply_result");
+
+    switch (result->result) {
+    case NET_HIT:
+        state->their_board.hits[r][c] = HIT;
+        break;
+    case NET_SINK:
+        state->their_board.hits[r][c] = HIT;
+        state->their_board.sunk[result->ship_type] = (struct placed_ship){
+            .row = result->ship_row,
+            .col = result->ship_col,
+            .dir = result->ship_dir,
+            .size = result->ship_size
+        };
+        state->their_ship_count--;
+        break;
+    case NET_MISS:
+        state->their_board.hits[r][c] = MISS;
+        break;
+    }
+
+    replay_add_move(&state->replay, 1, r, c, result);
+}
+
+static void print_our_result(struct pkt_move_result* result) {
+    switch (result->result) {
+    case NET_HIT:
+        printf("Hit! ");
+        break;
+    case NET_MISS:
+        printf("Miss! ");
+        break;
+    case NET_SINK:
+        printf("You sunk their %s! ", ship_name(result->ship_type));
+        break;
+    }
+}
+
+static void print_their_result(int r, int c, enum ship ship, struct pkt_move_result* result) {
+    switch (result->result) {
+    case NET_HIT:
+        printf("They shot at %c%i and hit your %s!\n", 
+            c + 'A',
+            r + 1,
+            ship_name(ship));
+        break;
+    case NET_SINK:
+        printf("They shot at %c%i and sunk your %s!\n",
+            c + 'A',
+            r + 1,
+            ship_name(ship));
+        break;
+    case NET_MISS:
+        printf("They shot at %c%i and missed.\n",
+            c + 'A',
+            r + 1);
+        break;
+    }
+}
+
+// Takes our turn. Returns 1 if we won.
+static int take_shot(struct connection* conn, struct game_state* state) {
     struct packet incoming, outgoing;
 
-    player_create_board(&state.board);
-    their_board_init(&state.their_board);
+    if (!state->script) {
+        printf("\nTHEIR BOARD:\n");
+        their_board_print(&state->their_board);
+        printf("Enter the square to shoot at (eg. A1, or nothing for a suggestion): ");
+    }
 
-    outgoing.type = PKT_SHIPS_READY;
+    int r, c;
+    get_shot(conn, state, NULL, 0, &r, &c);
+
+    outgoing.type = PKT_MOVE;
+    outgoing.move = (struct pkt_move){ .row = r, .col = c };
     send_packet(conn, &outgoing);
 
-    printf("Waiting for the other player...\n");
+    connection_set_timeout(conn, REPLY_TIMEOUT_MS);
+    EXPECT_PACKET(conn, incoming, PKT_MOVE_RESULT, "move result");
 
-    EXPECT_PACKET(conn, incoming, PKT_SHIPS_READY, "ships ready");
+    apply_result(state, r, c, &incoming.move_result);
 
-    if (conn->type == PEER_SERVER) {
-        outgoing.type = PKT_BEGIN_GAME;
-        outgoing.begin_game.first = state.turn = (enum peer_type)(rand() % 2);
-        send_packet(conn, &outgoing);
+    if (state->quiet) {
+        // Nothing to show.
+    } else if (state->script) {
+        printf("%c%i: ", c + 'A', r + 1);
+        print_our_result(&incoming.move_result);
+        putchar('\n');
     } else {
-        EXPECT_PACKET(conn, incoming, PKT_BEGIN_GAME, "begin game");
-        state.turn = incoming.begin_game.first;
+        printf("\nTHEIR BOARD:\n");
+        their_board_print(&state->their_board);
+        print_our_result(&incoming.move_result);
     }
 
-    printf("Begin!\n");
+    return incoming.move_result.win;
+}
 
-    while (1) {
-        if (state.turn == conn->type) {
-            printf("\nTHEIR BOARD:\n");
-            their_board_print(&state.their_board);
+// Takes our turn in salvo mode. Returns 1 if we won.
+static int take_salvo(struct connection* conn, struct game_state* state) {
+    struct packet incoming, outgoing;
 
-            int r, c;
+    if (!state->script) {
+        printf("\nTHEIR BOARD:\n");
+        their_board_print(&state->their_board);
+    }
 
-            while (1) {
-                printf("Enter the square to shoot at (eg. A1): ");
-                
-                if (player_get_coord(&r, &c))
-                    continue;
+    outgoing.type = PKT_SALVO;
+    outgoing.salvo.count = salvo_size(state->board.ship_count, state->their_board.hits);
 
-                if (state.their_board.hits[r][c] != HS_NONE) {
-                    printf("You've already shot at this square.\n");
-                    continue;
-                }
+    for (int i = 0; i < outgoing.salvo.count; i++) {
+        struct pkt_move* shot = &outgoing.salvo.shots[i];
+        if (!state->script)
+            printf("Enter shot %i of %i (eg. A1, or nothing for a suggestion): ", i + 1, outgoing.salvo.count);
+        get_shot(conn, state, outgoing.salvo.shots, i, &shot->row, &shot->col);
+    }
 
-                break;
-            }
+    send_packet(conn, &outgoing);
 
-            outgoing.type = PKT_MOVE;
-            outgoing.move = (struct pkt_move){ .row = r, .col = c };
-            send_packet(conn, &outgoing);
+    connection_set_timeout(conn, REPLY_TIMEOUT_MS);
+    EXPECT_PACKET(conn, incoming, PKT_SALVO_RESULT, "salvo result");
 
-            EXPECT_PACKET(conn, incoming, PKT_MOVE_RESULT, "move result");
+    if (incoming.salvo_result.count != outgoing.salvo.count) {
+        disconnectf(conn, "expected %i results in salvo result, got %i", outgoing.salvo.count, incoming.salvo_result.count);
+        exit(1);
+    }
 
-            switch (incoming.move_result.result) {
-            case NET_HIT:
-            case NET_SINK:
-                state.their_board.hits[r][c] = HIT;
-                break;
-            case NET_MISS:
-                state.their_board.hits[r][c] = MISS;
-                break;
-            }
+    int win = 0;
+    for (int i = 0; i < outgoing.salvo.count; i++) {
+        struct pkt_move* shot = &outgoing.salvo.shots[i];
+        apply_result(state, shot->row, shot->col, &incoming.salvo_result.results[i]);
+        win |= incoming.salvo_result.results[i].win;
+    }
 
-            printf("\nTHEIR BOARD:\n");
-            their_board_print(&state.their_board);
+    if (!state->script) {
+        printf("\nTHEIR BOARD:\n");
+        their_board_print(&state->their_board);
+    }
 
-            switch (incoming.move_result.result) {
-            case NET_HIT:
-                printf("Hit! ");
-                break;
-            case NET_MISS:
-                printf("Miss! ");
-                break;
-            case NET_SINK:
-                printf("You sunk their %s! ", ship_name(incoming.move_result.ship_type));
-                break;
-            }
+    for (int i = 0; i < outgoing.salvo.count && !state->quiet; i++) {
+        struct pkt_move* shot = &outgoing.salvo.shots[i];
+        printf("%c%i: ", shot->col + 'A', shot->row + 1);
+        print_our_result(&incoming.salvo_result.results[i]);
+        putchar('\n');
+    }
 
-            if (incoming.move_result.win) {
-                printf("\n\nYou won!\n");
-                break;
-            }
-        } else {
-            printf("Waiting for their move...\n");
-            EXPECT_PACKET(conn, incoming, PKT_MOVE, "move");
+    return win;
+}
 
-            int r = incoming.move.row, c = incoming.move.col;
+// Waits for their turn. Returns 1 if they won.
+static int receive_shot(struct connection* conn, struct game_state* state) {
+    struct packet incoming, outgoing;
 
-            if (state.board.hits[r][c] != HS_NONE) {
-                disconnectf(conn, "attempting to hit a square that was already hit");
-                exit(1);
-            }
+    if (!state->script)
+        printf("Waiting for their move...\n");
+    connection_set_timeout(conn, state->turn_timeout_ms);
+    EXPECT_PACKET(conn, incoming, PKT_MOVE, "move");
 
-            outgoing.type = PKT_MOVE_RESULT;
-            outgoing.move_result = (struct pkt_move_result){0};
-
-            enum ship ship = state.board.ships[r][c];
-            if (ship != SHIP_NONE) {
-                outgoing.move_result.result = NET_HIT;
-                state.board.hits[r][c] = HIT;
-                if (--state.board.placements[ship].count <= 0) {
-                    struct placed_ship sunk = state.board.placements[ship];
-                    outgoing.move_result.result = NET_SINK;
-                    outgoing.move_result.ship_row = sunk.row;
-                    outgoing.move_result.ship_col = sunk.col;
-                    outgoing.move_result.ship_dir = sunk.dir;
-                    outgoing.move_result.ship_size = sunk.size;
-                    outgoing.move_result.ship_type = ship;
-
-                    if (--state.board.ship_count <= 0) {
-                        outgoing.move_result.win = 1;
-                    }
-                }
-            } else {
-                outgoing.move_result.result = NET_MISS;
-                state.board.hits[r][c] = MISS;
-            }
+    int r = incoming.move.row, c = incoming.move.col;
+
+    if (state->board.hits[r][c] != HS_NONE) {
+        disconnectf(conn, "attempting to hit a square that was already hit");
+        exit(1);
+    }
 
-            send_packet(conn, &outgoing);
+    outgoing.type = PKT_MOVE_RESULT;
+    enum ship ship = resolve_shot(state, r, c, &outgoing.move_result);
 
-            printf("\nYOUR BOARD:\n");
-            ourboard_print(&state.board);
+    send_packet(conn, &outgoing);
 
-            switch (outgoing.move_result.result) {
-            case NET_HIT:
-                printf("They shot at %c%i and hit your %s!\n", 
-                    c + 'A',
-                    r + 1,
-                    ship_name(ship));
-                break;
-            case NET_SINK:
-                printf("They shot at %c%i and sunk your %s!\n",
-                    c + 'A',
-                    r + 1,
-                    ship_name(ship));
-                break;
-            case NET_MISS:
-                printf("They shot at %c%i and missed.\n",
-                    c + 'A',
-                    r + 1);
+    if (!state->script) {
+        printf("\nYOUR BOARD:\n");
+        ourboard_print(&state->board);
+    }
+
+    if (!state->quiet)
+        print_their_result(r, c, ship, &outgoing.move_result);
+
+    return outgoing.move_result.win;
+}
+
+// Waits for their turn in salvo mode. Returns 1 if they won.
+static int receive_salvo(struct connection* conn, struct game_state* state) {
+    struct packet incoming, outgoing;
+
+    if (!state->script)
+        printf("Waiting for their salvo...\n");
+    connection_set_timeout(conn, state->turn_timeout_ms);
+    EXPECT_PACKET(conn, incoming, PKT_SALVO, "salvo");
+
+    int expected = salvo_size(state->their_ship_count, state->board.hits);
+    if (incoming.salvo.count != expected) {
+        disconnectf(conn, "expected %i shots in salvo, got %i", expected, incoming.salvo.count);
+        exit(1);
+    }
+
+    enum ship ships[SALVO_MAX_SHOTS];
+    int win = 0;
+
+    outgoing.type = PKT_SALVO_RESULT;
+    outgoing.salvo_result.count = incoming.salvo.count;
+
+    for (int i = 0; i < incoming.salvo.count; i++) {
+        int r = incoming.salvo.shots[i].row, c = incoming.salvo.shots[i].col;
+
+        if (state->board.hits[r][c] != HS_NONE) {
+            disconnectf(conn, "attempting to hit a square that was already hit");
+            exit(1);
+        }
+
+        ships[i] = resolve_shot(state, r, c, &outgoing.salvo_result.results[i]);
+        win |= outgoing.salvo_result.results[i].win;
+    }
+
+    send_packet(conn, &outgoing);
+
+    if (!state->script) {
+        printf("\nYOUR BOARD:\n");
+        ourboard_print(&state->board);
+    }
+
+    for (int i = 0; i < incoming.salvo.count && !state->quiet; i++) {
+        struct pkt_move* shot = &incoming.salvo.shots[i];
+        print_their_result(shot->row, shot->col, ships[i], &outgoing.salvo_result.results[i]);
+    }
+
+    return win;
+}
+
+static void play_game(struct connection* conn, struct game_options* options) {
+    struct game_state state;
+    struct packet incoming, outgoing;
+    enum game_mode mode = options->mode;
+
+    state.script = options->script;
+    state.quiet = options->quiet;
+    if (!state.script) {
+        player_create_board(&state.board, options->pool);
+    } else if (script_place(state.script, &state.board)) {
+        disconnectf(conn, "script error");
+        exit(1);
+    }
+    their_board_init(&state.their_board);
+    state.mode = mode;
+    state.their_ship_count = state.board.ship_count;
+    state.turn_timeout_ms = options->turn_timeout_ms;
+
+    state.replay.mode = mode;
+    state.replay.move_count = 0;
+    memcpy(state.replay.ships, state.board.placements, sizeof state.replay.ships);
+
+    struct opponent_store opponents = {0};
+    struct placement_prior prior;
+    state.prior = NULL;
+
+    if (options->opponents_path && opponent_store_load(&opponents, options->opponents_path) == 0) {
+        struct opponent_history* history = opponent_store_get(&opponents, options->opponent, 0);
+        if (history) {
+            opponent_prior(history, &prior);
+            state.prior = &prior;
+        }
+    }
+
+    outgoing.type = PKT_SHIPS_READY;
+    send_packet(conn, &outgoing);
+
+    if (!state.script)
+        printf("Waiting for the other player...\n");
+
+    connection_set_timeout(conn, IDLE_TIMEOUT_MS);
+    EXPECT_PACKET(conn, incoming, PKT_SHIPS_READY, "ships ready");
+
+    if (conn->type == PEER_SERVER) {
+        outgoing.type = PKT_BEGIN_GAME;
+        outgoing.begin_game.first = state.turn = (enum peer_type)(rand() % 2);
+        send_packet(conn, &outgoing);
+    } else {
+        connection_set_timeout(conn, REPLY_TIMEOUT_MS);
+        EXPECT_PACKET(conn, incoming, PKT_BEGIN_GAME, "begin game");
+        state.turn = incoming.begin_game.first;
+    }
+
+    state.replay.we_went_first = state.turn == conn->type;
+
+    if (!state.script)
+        printf(mode == MODE_SALVO ? "Begin! (salvo)\n" : "Begin!\n");
+
+    while (1) {
+        if (state.turn == conn->type) {
+            int won = mode == MODE_SALVO ? take_salvo(conn, &state) : take_shot(conn, &state);
+            if (won) {
+                if (!state.quiet)
+                    printf("\n\nYou won!\n");
+                state.replay.won = 1;
                 break;
             }
-
-            if (outgoing.move_result.win) {
-                printf("\nYou lost!\n");
+        } else {
+            int lost = mode == MODE_SALVO ? receive_salvo(conn, &state) : receive_shot(conn, &state);
+            if (lost) {
+                if (!state.quiet)
+                    printf("\nYou lost!\n");
+                state.replay.won = 0;
                 break;
             }
 
-            printf("Press enter to continue...");
-            skipline();
+            if (!state.script) {
+                printf("Press enter to continue...");
+                skipline();
+            }
         }
 
         state.turn = state.turn == PEER_SERVER ? PEER_CLIENT : PEER_SERVER;
     }
+
+    if (options->record_path)
+        replay_append(options->record_path, &state.replay);
+
+    // What we loaded at the start may be stale by now, other games can share the file.
+    if (options->opponents_path) {
+        opponent_store_record(options->opponents_path, options->opponent, &state.their_board);
+        opponent_store_free(&opponents);
+    }
+
+    struct rating_store ratings;
+    if (options->ratings_path && options->server_records_ratings) {
+        printf("The server records this game in your shared rating store.\n");
+    } else if (options->ratings_path && rating_store_open(&ratings, options->ratings_path) == 0) {
+        struct rating_game game = {
+            .winner = state.replay.won ? options->name : options->opponent,
+            .loser = state.replay.won ? options->opponent : options->name
+        };
+        rating_store_record(&ratings, &game, 1);
+
+        u32 rank;
+        const struct rating_player* player = rating_store_find(&ratings, options->name, &rank);
+        if (player)
+            printf("Your rating: %.0f (#%u of %u)\n", player->rating, rank, ratings.count);
+        rating_store_close(&ratings);
+    }
 }
 
-static void server(const char* port) {
+// Opens a socket of one family bound to every address on the port. Returns -1 with what went
+// wrong in `error` if it can't.
+static int listen_socket(int family, const char* port, char* error, size_t error_size) {
     int status;
     struct addrinfo hints, *res;
 
     memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_INET;
+    hints.ai_family = family;
     hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_NUMERICSERV;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
 
-    if ((status = getaddrinfo("0.0.0.0", port, &hints, &res))) {
-        fprintf(stderr, "getaddrinfo error: %s\n", gai_strerror(status));
-        exit(1);
+    if ((status = getaddrinfo(NULL, port, &hints, &res))) {
+        snprintf(error, error_size, "getaddrinfo error: %s", gai_strerror(status));
+        return -1;
     }
 
+    const char* step = "socket error";
+    int yes = 1, no = 0;
     int sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (sockfd < 0) {
-        perror("socket error");
-        exit(1);
-    }
+    if (sockfd < 0)
+        goto fail;
+
+    step = "setsockopt error";
+    if (res->ai_family == AF_INET6 && setsockopt(sockfd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof no) < 0)
+        goto fail;
 
     // Reuse the port to prevent "already in use" errors
-    int yes = 1;
-    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes) < 0) {
-        perror("setsockopt error");
-        exit(1);
-    }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes) < 0)
+        goto fail;
+
+    // Let several servers listen on the same port. The kernel spreads incoming clients across
+    // them, so one machine can host as many games as there are server processes.
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof yes) < 0)
+        goto fail;
+
+    step = "bind error";
+    if (bind(sockfd, res->ai_addr, res->ai_addrlen) < 0)
+        goto fail;
+
+    freeaddrinfo(res);
+    return sockfd;
+
+fail:
+    snprintf(error, error_size, "%s: %s", step, strerror(errno));
+    if (sockfd >= 0)
+        close(sockfd);
+    freeaddrinfo(res);
+    return -1;
+}
+
+// Opens a socket listening on every address. The IPv6 socket takes IPv4 clients too. If IPv6 is
+// missing or switched off in any way, we listen on IPv4 alone. Without a port we take any free
+// one, which tcp_accept() prints.
+static int tcp_listen(const char* port) {
+    char error[256];
+    if (!port)
+        port = "0";
+
+    int sockfd = listen_socket(AF_INET6, port, error, sizeof error);
+    if (sockfd < 0)
+        sockfd = listen_socket(AF_INET, port, error, sizeof error);
 
-    if (bind(sockfd, res->ai_addr, res->ai_addrlen) < 0) {
-        perror("bind error");
+    if (sockfd < 0) {
+        fprintf(stderr, "%s\n", error);
         exit(1);
     }
+    return sockfd;
+}
+
+// Waits for a client on the given TCP port and returns its socket.
+static int tcp_accept(const char* port) {
+    int sockfd = tcp_listen(port);
 
     if (listen(sockfd, 1) < 0) {
         perror("listen error");
@@ -226,15 +625,20 @@ static void server(const char* port) {
 
     // After binding, inspect the port and print it out
     {
-        struct sockaddr_in new_addr;
+        struct sockaddr_storage new_addr;
         socklen_t new_addr_len = sizeof new_addr;
         if (getsockname(sockfd, (struct sockaddr*)&new_addr, &new_addr_len) < 0) {
             perror("getsockname error");
             exit(1);
         }
 
-        if (new_addr.sin_family == AF_INET)
-            printf("Server listening on port %i\n", ntohs(new_addr.sin_port));
+        if (new_addr.ss_family == AF_INET)
+            printf("Server listening on port %i\n", ntohs(((struct sockaddr_in*)&new_addr)->sin_port));
+        else if (new_addr.ss_family == AF_INET6)
+            printf("Server listening on port %i\n", ntohs(((struct sockaddr_in6*)&new_addr)->sin6_port));
+
+        // Whoever started us may be waiting on this line to know where to connect.
+        fflush(stdout);
     }
 
     struct sockaddr_storage caddr;
@@ -245,36 +649,134 @@ static void server(const char* port) {
         exit(1);
     }
 
-    printf("Got client connection...\n");
+    // We only host one game, so stop listening and let the other servers on this port take the
+    // next clients.
+    close(sockfd);
 
-    struct connection conn = { 
-        .type = PEER_SERVER, 
-        .is_disconnected = 0,
-        .fd = cfd 
-    };
+    return cfd;
+}
+
+// Names the other end of a socket by its address. Ports are left out since a client gets a new
+// one every time it connects.
+static void peer_name(int fd, char* name, size_t size) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof addr;
+    name[0] = '\0';
+
+    if (getpeername(fd, (struct sockaddr*)&addr, &addr_len) < 0)
+        return;
+
+    // IPv4 clients of the dual-stack listener show up as ::ffff:a.b.c.d. They're named by their
+    // IPv4 address so opponent history from before the listener took IPv6 still matches.
+    struct in6_addr* addr6 = &((struct sockaddr_in6*)&addr)->sin6_addr;
+    if (addr.ss_family == AF_INET)
+        inet_ntop(AF_INET, &((struct sockaddr_in*)&addr)->sin_addr, name, size);
+    else if (addr.ss_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(addr6))
+        inet_ntop(AF_INET, &addr6->s6_addr[12], name, size);
+    else if (addr.ss_family == AF_INET6)
+        inet_ntop(AF_INET6, addr6, name, size);
+}
+
+// Opens a connection for a shm:<name> address, which plays over shared memory instead of TCP.
+// Returns -1 if the address isn't a shared memory one.
+static int shm_address(const char* address, char* name, size_t size) {
+    if (!address || strncmp(address, "shm:", 4) != 0)
+        return -1;
+
+    snprintf(name, size, "/battleship-%s", address + 4);
+    return 0;
+}
+
+// Says who we are in our hello. Peers only read this from version 2 on.
+static void hello_identify(struct pkt_hello* hello, struct game_options* options) {
+    snprintf(hello->name, NET_NAME_LENGTH, "%s", options->name);
+    hello->ratings_id = options->ratings_path ? rating_store_identity(options->ratings_path) : 0;
+}
+
+// Keys the opponent by the name from their hello rather than their address, when they gave one.
+// Someone using our own name is still told apart by their address.
+static void hello_peer(const struct pkt_hello* hello, struct game_options* options) {
+    if (hello->name[0] && strcmp(hello->name, options->name) != 0)
+        snprintf(options->opponent, OPPONENT_NAME_LENGTH, "%s", hello->name);
+}
 
+// Waits for the client's hello, agrees on the mode and protocol and tells the client to start.
+static void server_handshake(struct connection* conn, struct game_options* options) {
     struct packet incoming, outgoing;
-    
-    EXPECT_PACKET(&conn, incoming, PKT_CLIENT_HELLO, "client hello");
 
-    outgoing = (struct packet){ .type = PKT_SERVER_HELLO };
-    send_packet(&conn, &outgoing);
+    EXPECT_PACKET(conn, incoming, PKT_CLIENT_HELLO, "client hello");
+
+    // Salvo is only played if both sides asked for it.
+    if (incoming.hello.mode != options->mode) {
+        if (options->mode == MODE_SALVO)
+            printf("The client doesn't want to play salvo, falling back to classic.\n");
+        options->mode = MODE_CLASSIC;
+    }
+
+    // Both sides use the older of the two versions and whatever capabilities they share. A version 1
+    // client gets a version 1 hello back, it wouldn't understand anything longer. A client that sent
+    // the bare magic also gets the bare magic back, since it's always held to classic above.
+    int version = incoming.hello.version < options->protocol ? incoming.hello.version : options->protocol;
+    u16 capabilities = version >= 2 ? incoming.hello.capabilities & NET_CAPABILITIES : 0;
+
+    outgoing = (struct packet){
+        .type = PKT_SERVER_HELLO,
+        .hello = { .mode = options->mode, .version = version, .capabilities = capabilities }
+    };
+    hello_identify(&outgoing.hello, options);
+    send_packet(conn, &outgoing);
+    hello_peer(&incoming.hello, options);
+    connection_set_protocol(conn, version, capabilities);
 
-    printf("Connected! When you're ready, press enter to begin.");
-    skipline();
+    if (!options->script) {
+        printf("Connected! When you're ready, press enter to begin.");
+        skipline();
+    }
 
     outgoing = (struct packet){ .type = PKT_SERVER_READY };
-    send_packet(&conn, &outgoing);
+    send_packet(conn, &outgoing);
+}
 
-    play_game(&conn);
+static void server(const char* port, struct game_options* options) {
+    struct connection conn;
+    char shm_name[256];
+
+    if (shm_address(port, shm_name, sizeof shm_name) == 0) {
+        if (shm_connection_create(&conn, shm_name))
+            exit(1);
+
+        printf("Server waiting on %s\n", port);
+        snprintf(options->opponent, OPPONENT_NAME_LENGTH, "%s", port);
+
+        // There's no accept() here, the client's hello is the first sign of it.
+        connection_set_timeout(&conn, IDLE_TIMEOUT_MS);
+    } else {
+        tcp_connection_init(&conn, PEER_SERVER, tcp_accept(port));
+        printf("Got client connection...\n");
+        peer_name(conn.fd, options->opponent, OPPONENT_NAME_LENGTH);
+
+        // A real player sends a packet or two per turn, anything much faster is a broken or
+        // hostile client.
+        connection_set_rate_limit(&conn, options->rate_limit,
+            RATE_LIMIT_BURST > 2 * options->rate_limit ? RATE_LIMIT_BURST : 2 * options->rate_limit);
+
+        connection_set_timeout(&conn, REPLY_TIMEOUT_MS);
+    }
+
+    server_handshake(&conn, options);
+    play_game(&conn, options);
+    connection_close(&conn);
 }
 
-static void client(const char* host, const char* port) {
+// Connects to a server over TCP and returns the socket. Every address the host resolves to gets a
+// non-blocking connect, happy eyeballs style: a new attempt starts every CONNECT_ATTEMPT_DELAY_MS,
+// or as soon as one fails, and the first to connect wins. A dead address only costs the delay.
+static int tcp_connect(const char* host, const char* port) {
     int status;
     struct addrinfo hints, *res;
 
     memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_INET;
+    hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_NUMERICSERV;
 
@@ -283,56 +785,528 @@ static void client(const char* host, const char* port) {
         exit(1);
     }
 
-    int sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    // Alternate between address families, starting with the one the resolver prefers, so a broken
+    // IPv6 route can't hold up IPv4 behind a list of IPv6 addresses.
+    struct addrinfo* addrs[CONNECT_MAX_ADDRESSES];
+    int count = 0;
+    for (struct addrinfo* preferred = res, *other = res; count < CONNECT_MAX_ADDRESSES && (preferred || other);) {
+        while (preferred && preferred->ai_family != res->ai_family)
+            preferred = preferred->ai_next;
+        while (other && other->ai_family == res->ai_family)
+            other = other->ai_next;
+
+        if (preferred) {
+            addrs[count++] = preferred;
+            preferred = preferred->ai_next;
+        }
+        if (other && count < CONNECT_MAX_ADDRESSES) {
+            addrs[count++] = other;
+            other = other->ai_next;
+        }
+    }
+
+    struct pollfd pending[CONNECT_MAX_ADDRESSES];
+    int pending_count = 0, next = 0, sockfd = -1, error = ETIMEDOUT;
+    u64 deadline = time_ms() + CONNECT_TIMEOUT_MS, next_attempt = 0;
+
+    while (sockfd < 0) {
+        u64 now = time_ms();
+        if (now >= deadline) {
+            error = ETIMEDOUT;
+            break;
+        }
+
+        if (next < count && (now >= next_attempt || pending_count == 0)) {
+            struct addrinfo* addr = addrs[next++];
+            int fd = socket(addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK, addr->ai_protocol);
+            if (fd < 0) {
+                error = errno;
+                continue;
+            }
+
+            if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+                sockfd = fd;
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                error = errno;
+                close(fd);
+                continue;
+            }
+
+            pending[pending_count++] = (struct pollfd){ .fd = fd, .events = POLLOUT };
+            next_attempt = now + CONNECT_ATTEMPT_DELAY_MS;
+            continue;
+        }
+
+        // Every address failed.
+        if (pending_count == 0)
+            break;
+
+        u64 wake = next < count && next_attempt < deadline ? next_attempt : deadline;
+        if (poll(pending, pending_count, (int)(wake - now)) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll error");
+            exit(1);
+        }
+
+        for (int i = 0; i < pending_count; i++) {
+            if (!pending[i].revents)
+                continue;
+
+            int fd = pending[i].fd, fd_error = 0;
+            socklen_t length = sizeof fd_error;
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &fd_error, &length) < 0)
+                fd_error = errno;
+
+            pending[i--] = pending[--pending_count];
+            if (fd_error == 0 && sockfd < 0) {
+                sockfd = fd;
+            } else {
+                error = fd_error ? fd_error : error;
+                close(fd);
+                next_attempt = 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < pending_count; i++)
+        close(pending[i].fd);
+    freeaddrinfo(res);
+
     if (sockfd < 0) {
-        perror("socket error");
+        errno = error;
+        perror("connect error");
         exit(1);
     }
 
-    if (connect(sockfd, res->ai_addr, res->ai_addrlen) < 0) {
-        perror("connect error");
+    // The rest of the game uses blocking sends.
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) & ~O_NONBLOCK);
+    return sockfd;
+}
+
+// Says hello to the server and waits until it's ready to start.
+static void client_handshake(struct connection* conn, struct game_options* options) {
+    struct packet incoming, outgoing;
+
+    outgoing = (struct packet){
+        .type = PKT_CLIENT_HELLO,
+        .hello = {
+            .mode = options->mode,
+            .version = options->protocol,
+            .capabilities = options->protocol >= 2 ? NET_CAPABILITIES : 0
+        }
+    };
+    hello_identify(&outgoing.hello, options);
+    send_packet(conn, &outgoing);
+    
+    connection_set_timeout(conn, REPLY_TIMEOUT_MS);
+    EXPECT_PACKET(conn, incoming, PKT_SERVER_HELLO, "server hello");
+
+    if (incoming.hello.version > options->protocol || (incoming.hello.capabilities & ~outgoing.hello.capabilities)) {
+        disconnectf(conn, "protocol error: server picked a version or capability we didn't offer");
+        exit(1);
+    }
+    // The server can only agree to our mode or fall back to classic.
+    if (incoming.hello.mode != options->mode && incoming.hello.mode != MODE_CLASSIC) {
+        disconnectf(conn, "protocol error: server picked a game mode we didn't ask for");
         exit(1);
     }
+    connection_set_protocol(conn, incoming.hello.version, incoming.hello.capabilities);
+
+    // When both players record to the same store, the server records for both.
+    hello_peer(&incoming.hello, options);
+    options->server_records_ratings = outgoing.hello.ratings_id && incoming.hello.ratings_id == outgoing.hello.ratings_id;
+
+    if (incoming.hello.mode != options->mode && !options->quiet)
+        printf("The server doesn't want to play salvo, falling back to classic.\n");
+    options->mode = incoming.hello.mode;
+
+    if (!options->quiet)
+        printf("Connected! Waiting for host to begin...\n");
+
+    connection_set_timeout(conn, IDLE_TIMEOUT_MS);
+    EXPECT_PACKET(conn, incoming, PKT_SERVER_READY, "server ready");
+}
+
+static void client(const char* host, const char* port, struct game_options* options) {
+    struct connection conn;
+    char shm_name[256];
+
+    if (shm_address(host, shm_name, sizeof shm_name) == 0) {
+        if (shm_connection_open(&conn, shm_name))
+            exit(1);
+        snprintf(options->opponent, OPPONENT_NAME_LENGTH, "%s", host);
+    } else {
+        tcp_connection_init(&conn, PEER_CLIENT, tcp_connect(host, port));
+        peer_name(conn.fd, options->opponent, OPPONENT_NAME_LENGTH);
+    }
 
     printf("Got server connection...\n");
 
-    struct connection conn = {
-        .type = PEER_CLIENT,
-        .is_disconnected = 0,
-        .fd = sockfd
+    client_handshake(&conn, options);
+    play_game(&conn, options);
+    connection_close(&conn);
+}
+
+struct local_bot {
+    struct connection conn;
+    struct game_options options;
+    char name[OPPONENT_NAME_LENGTH];
+};
+
+static void* local_bot_main(void* arg) {
+    struct local_bot* bot = arg;
+    client_handshake(&bot->conn, &bot->options);
+    play_game(&bot->conn, &bot->options);
+    connection_close(&bot->conn);
+    return NULL;
+}
+
+// Plays against a bot without a network. The bot is an ordinary client on its own thread, talking
+// to us over the in-process transport, so a local game goes through the same protocol code as a
+// networked one.
+static int local(const char* bot_name, u64 seed, struct game_options* options) {
+    const struct strategy* strategy = strategy_find(bot_name);
+    if (!strategy) {
+        fprintf(stderr, "no strategy called %s\n", bot_name);
+        return -1;
+    }
+
+    struct script script;
+    if (script_open(&script, NULL, strategy, seed))
+        return -1;
+
+    struct local_bot bot = {
+        .options = {
+            .mode = options->mode,
+            .turn_timeout_ms = 0,
+            .script = &script,
+            .rate_limit = 0,
+            .protocol = NET_VERSION,
+            .quiet = 1
+        }
     };
 
-    struct packet incoming, outgoing;
+    struct connection conn;
+    if (mem_connection_pair(&conn, &bot.conn)) {
+        fprintf(stderr, "couldn't set up the local connection\n");
+        script_close(&script);
+        return -1;
+    }
 
-    outgoing = (struct packet){ .type = PKT_CLIENT_HELLO };
-    send_packet(&conn, &outgoing);
-    
-    EXPECT_PACKET(&conn, incoming, PKT_SERVER_HELLO, "server hello");
+    // The bot introduces itself in its hello like any client, under a name no person would have.
+    snprintf(bot.name, OPPONENT_NAME_LENGTH, "bot:%s", strategy->name);
+    bot.options.name = bot.name;
+    snprintf(options->opponent, OPPONENT_NAME_LENGTH, "%s", bot.name);
+    snprintf(bot.options.opponent, OPPONENT_NAME_LENGTH, "%s", options->name);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, local_bot_main, &bot)) {
+        fprintf(stderr, "couldn't start the bot\n");
+        connection_close(&conn);
+        connection_close(&bot.conn);
+        script_close(&script);
+        return -1;
+    }
+
+    server_handshake(&conn, options);
+    play_game(&conn, options);
 
-    printf("Connected! Waiting for host to begin...\n");
+    pthread_join(thread, NULL);
+    connection_close(&conn);
+    script_close(&script);
+    return 0;
+}
+
+// Looks up the strategies named on the command line, or takes everything registered if none are
+// named. Returns how many, or -1 if a name is unknown or there are more than STRATEGY_MAX.
+static int parse_strategies(int argc, const char** argv, const struct strategy** strategies) {
+    if (argc > STRATEGY_MAX) {
+        fprintf(stderr, "at most %i strategies at once\n", STRATEGY_MAX);
+        return -1;
+    }
 
-    EXPECT_PACKET(&conn, incoming, PKT_SERVER_READY, "server ready");
+    for (int i = 0; i < argc; i++) {
+        if (!(strategies[i] = strategy_find(argv[i]))) {
+            fprintf(stderr, "no strategy called %s\n", argv[i]);
+            return -1;
+        }
+    }
+    if (argc > 0)
+        return argc;
 
-    play_game(&conn);
+    int count = strategy_count() < STRATEGY_MAX ? strategy_count() : STRATEGY_MAX;
+    for (int i = 0; i < count; i++)
+        strategies[i] = strategy_get(i);
+    return count;
 }
 
 int main(int argc, const char** argv) {
     srand(time(NULL));
 
+    // Pull out flags, leaving the positional arguments in place.
+    struct game_options options = {
+        .mode = MODE_CLASSIC,
+        .turn_timeout_ms = TURN_TIMEOUT_MS,
+        .record_path = NULL,
+        .opponents_path = NULL,
+        .opponent = {0},
+        .ratings_path = NULL,
+        .name = getenv("USER") ? getenv("USER") : "me",
+        .pool = NULL,
+        .script = NULL,
+        .rate_limit = -1,
+        .protocol = NET_VERSION
+    };
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    struct optimize_options optimize_options = {
+        .layouts = 16,
+        .iterations = 200,
+        .games = 16,
+        .seed = (u64)time(NULL),
+        .strategy = NULL
+    };
+    struct tournament_options tournament_options = {
+        .games = 1000,
+        .seed = optimize_options.seed
+    };
+    struct export_options export_options = {
+        .games = 10000,
+        .seed = optimize_options.seed,
+        .shard_samples = 1 << 20
+    };
+    // Fixed by default so any two runs, and any two builds, play the same games.
+    struct bench_options bench_options = {
+        .layouts = 2000,
+        .seed = 1
+    };
+    const char* pool_path = NULL;
+    const char* strategy_name = "ai";
+    const char* script_path = NULL;
+    const char* book_path = NULL;
+    int depth = 12;
+    int top = 10;
+    const char* bot_name = NULL;
+    int seeded = 0;
+    int nargs = 0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--salvo") == 0)
+            options.mode = MODE_SALVO;
+        else if (strcmp(argv[i], "--turn-time") == 0 && i + 1 < argc)
+            options.turn_timeout_ms = atoi(argv[++i]) * 1000;
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            options.record_path = argv[++i];
+        else if (strcmp(argv[i], "--opponents") == 0 && i + 1 < argc)
+            options.opponents_path = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc)
+            pool_path = argv[++i];
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            optimize_options.layouts = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            optimize_options.iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+            optimize_options.games = tournament_options.games = export_options.games = bench_options.layouts = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            optimize_options.seed = tournament_options.seed = export_options.seed = bench_options.seed = strtoull(argv[++i], NULL, 10), seeded = 1;
+        else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc)
+            strategy_name = argv[++i];
+        else if (strcmp(argv[i], "--ratings") == 0 && i + 1 < argc)
+            options.ratings_path = argv[++i];
+        else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+            options.name = argv[++i];
+        else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc)
+            book_path = argv[++i];
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            top = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+            script_path = argv[++i];
+        else if (strcmp(argv[i], "--bot") == 0 && i + 1 < argc)
+            bot_name = argv[++i];
+        else if (strcmp(argv[i], "--rate-limit") == 0 && i + 1 < argc)
+            options.rate_limit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--protocol") == 0 && i + 1 < argc)
+            options.protocol = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--shard-samples") == 0 && i + 1 < argc)
+            export_options.shard_samples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--plugin") == 0 && i + 1 < argc) {
+            if (strategy_load_plugin(argv[++i]))
+                return 1;
+        }
+        else
+            argv[nargs++] = argv[i];
+    }
+    argc = nargs;
+
+    struct layout_pool pool;
+    if (pool_path) {
+        if (layout_pool_load(&pool, pool_path))
+            return 1;
+        options.pool = &pool;
+    }
+
+    // The book is never closed, the AI uses it until exit.
+    struct opening_book book;
+    if (book_path) {
+        if (book_open(&book, book_path))
+            return 1;
+        ai_use_book(&book);
+    }
+
+    struct script script;
+    if (script_path || bot_name) {
+        const struct strategy* bot = strategy_find(bot_name ? bot_name : "ai");
+        if (!bot) {
+            fprintf(stderr, "no strategy called %s\n", bot_name);
+            return 1;
+        }
+
+        // Many scripted games are started at once, so the time alone isn't enough to tell them apart.
+        u64 seed = seeded ? optimize_options.seed : optimize_options.seed ^ ((u64)getpid() << 32);
+        if (script_open(&script, script_path, bot, seed))
+            return 1;
+        options.script = &script;
+    }
+
+    if (options.protocol < 1 || options.protocol > NET_VERSION) {
+        fprintf(stderr, "--protocol must be between 1 and %i\n", NET_VERSION);
+        return 1;
+    }
+
+    // Scripted games go as fast as they can, which would trip the limit meant for people.
+    if (options.rate_limit < 0)
+        options.rate_limit = options.script ? 0 : RATE_LIMIT_PER_SECOND;
+
     if (argc >= 2 && strcmp(argv[1], "server") == 0) {
-        server(argc > 2 ? argv[2] : NULL);
+        server(argc > 2 ? argv[2] : NULL, &options);
+        if (options.script)
+            script_close(options.script);
     } else if (argc >= 2 && strcmp(argv[1], "client") == 0) {
-        if (argc < 4) {
-            fprintf(stderr, "Usage: %s client <host> <port>\n", argv[0]);
+        if (argc < 4 && !(argc == 3 && strncmp(argv[2], "shm:", 4) == 0)) {
+            fprintf(stderr, "Usage: %s client <host> <port> [--salvo]\n", argv[0]);
+            return 1;
+        }
+
+        client(argv[2], argc > 3 ? argv[3] : NULL, &options);
+        if (options.script)
+            script_close(options.script);
+    } else if (argc >= 2 && strcmp(argv[1], "local") == 0) {
+        int status = local(argc > 2 ? argv[2] : "ai", optimize_options.seed, &options);
+        if (options.script)
+            script_close(options.script);
+        return status ? 1 : 0;
+    } else if (argc >= 3 && strcmp(argv[1], "analyze") == 0) {
+        return analyze(argv[2], threads) ? 1 : 0;
+    } else if (argc >= 3 && strcmp(argv[1], "optimize") == 0) {
+        optimize_options.threads = threads;
+        optimize_options.strategy = strategy_find(strategy_name);
+        if (!optimize_options.strategy) {
+            fprintf(stderr, "no strategy called %s\n", strategy_name);
             return 1;
         }
+        if (optimize_options.layouts < 1 || optimize_options.iterations < 0 || optimize_options.games < 1) {
+            fprintf(stderr, "--count and --games must be at least 1\n");
+            return 1;
+        }
+        return optimize(argv[2], &optimize_options) ? 1 : 0;
+    } else if (argc >= 2 && strcmp(argv[1], "tournament") == 0) {
+        const struct strategy* strategies[STRATEGY_MAX];
+        int count = parse_strategies(argc - 2, argv + 2, strategies);
+        if (count < 0)
+            return 1;
 
-        client(argv[2], argv[3]);
+        tournament_options.threads = threads;
+        if (tournament_options.games < 1) {
+            fprintf(stderr, "--games must be at least 1\n");
+            return 1;
+        }
+        return tournament(strategies, count, &tournament_options) ? 1 : 0;
+    } else if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        const struct strategy* strategies[STRATEGY_MAX];
+        int count = parse_strategies(argc - 2, argv + 2, strategies);
+        if (count < 0)
+            return 1;
+
+        if (bench_options.layouts < 1) {
+            fprintf(stderr, "--games must be at least 1\n");
+            return 1;
+        }
+        return bench(strategies, count, &bench_options) ? 1 : 0;
+    } else if (argc >= 3 && strcmp(argv[1], "book") == 0) {
+        if (depth < 1) {
+            fprintf(stderr, "--depth must be at least 1\n");
+            return 1;
+        }
+
+        // A new book has to come from the live AI, not an old book.
+        ai_use_book(NULL);
+        return book_generate(argv[2], depth, threads) ? 1 : 0;
+    } else if (argc >= 3 && strcmp(argv[1], "ratings") == 0) {
+        struct rating_store ratings;
+        if (rating_store_open(&ratings, argv[2]))
+            return 1;
+
+        // The top of the leaderboard, unless particular players are asked for.
+        if (argc == 3) {
+            const struct rating_player** players = calloc(top > 0 ? top : 1, sizeof(struct rating_player*));
+            int n = players ? rating_store_top(&ratings, top, players) : 0;
+            for (int i = 0; i < n; i++)
+                printf("%6i  %-40s %6.0f %8u games\n", i + 1, players[i]->name, players[i]->rating, players[i]->games);
+            free(players);
+        }
+
+        for (int i = 3; i < argc; i++) {
+            u32 rank;
+            const struct rating_player* player = rating_store_find(&ratings, argv[i], &rank);
+            if (player)
+                printf("%6u  %-40s %6.0f %8u games\n", rank, player->name, player->rating, player->games);
+            else
+                printf("%s hasn't played\n", argv[i]);
+        }
+
+        printf("%u players\n", ratings.count);
+        rating_store_close(&ratings);
+    } else if (argc >= 3 && strcmp(argv[1], "export") == 0) {
+        export_options.threads = threads;
+        export_options.strategy = strategy_find(strategy_name);
+        if (!export_options.strategy) {
+            fprintf(stderr, "no strategy called %s\n", strategy_name);
+            return 1;
+        }
+        if (export_options.games < 1 || export_options.shard_samples < 1) {
+            fprintf(stderr, "--games and --shard-samples must be at least 1\n");
+            return 1;
+        }
+        return export_samples(argv[2], &export_options) ? 1 : 0;
     } else {
         fprintf(stderr, 
-            "Run a server with: %s server [port]\n"
-            "Connect to the server with: %s client <host> <port>\n", 
-            argv[0], argv[0]);
+            "Run a server with: %s server [port] [--salvo]\n"
+            "Connect to the server with: %s client <host> <port> [--salvo]\n"
+            "Play against a bot on this machine with: %s local [strategy] [--salvo]\n"
+            "Use shm:<name> in place of the port (server) or host (client) to play over shared memory.\n"
+            "--turn-time <seconds> sets how long the other player gets per move (0 for no limit).\n"
+            "--record <file> appends the game to a replay file.\n"
+            "--opponents <file> learns where each opponent places ships, to sharpen shot suggestions.\n"
+            "--pool <file> picks your fleet from a layout pool instead of at random.\n"
+            "--script <file> (- for stdin) plays the moves in a file, --bot <strategy> plays for you (see README).\n"
+            "--ratings <file> updates Elo ratings after each game, --name <name> is who you are in them.\n"
+            "Show the leaderboard with: %s ratings <file> [--top <n>] [player...]\n"
+            "--rate-limit <n> caps the packets per second a client may send (0 for no limit).\n"
+            "--protocol 1 connects to servers from before protocol version 2.\n"
+            "Summarize a replay file with: %s analyze <file> [--threads <n>]\n"
+            "Build a layout pool with: %s optimize <file> [--count <n>] [--iterations <n>] [--games <n>] [--threads <n>] [--seed <n>] [--strategy <name>]\n"
+            "Rate strategies against each other with: %s tournament [strategy...] [--games <n>] [--threads <n>] [--seed <n>]\n"
+            "Benchmark strategies on a fixed set of fleets with: %s bench [strategy...] [--games <n>] [--seed <n>]\n"
+            "Write self-play training data with: %s export <dir> [--games <n>] [--threads <n>] [--seed <n>] [--strategy <name>] [--shard-samples <n>]\n"
+            "Build an opening book with: %s book <file> [--depth <shots>] [--threads <n>]\n"
+            "--book <file> makes the AI play its first shots from an opening book.\n"
+            "--plugin <file.so> loads more strategies from a shared object (see strategy.h).\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "mpsc.h"
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Each slot is a sequence number followed by the element. The sequence tells whose turn the slot
+// is: `pos` means it's free for the producer claiming position pos, `pos + 1` means it holds the
+// element for pos and the consumer can take it.
+static _Atomic size_t* slot_seq(struct mpsc_queue* queue, size_t pos) {
+    return (_Atomic size_t*)(queue->slots + (pos & queue->mask) * queue->stride);
+}
+
+static void* slot_data(struct mpsc_queue* queue, size_t pos) {
+    return queue->slots + (pos & queue->mask) * queue->stride + sizeof(_Atomic size_t);
+}
+
+int mpsc_init(struct mpsc_queue* queue, size_t capacity, size_t elem_size) {
+    memset(queue, 0, sizeof(struct mpsc_queue));
+
+    queue->capacity = 1;
+    while (queue->capacity < capacity)
+        queue->capacity <<= 1;
+    queue->mask = queue->capacity - 1;
+
+    queue->elem_size = elem_size;
+    queue->stride = (sizeof(_Atomic size_t) + elem_size + 7) & ~(size_t)7;
+
+    queue->slots = aligned_alloc(64, (queue->capacity * queue->stride + 63) & ~(size_t)63);
+    if (!queue->slots)
+        return -1;
+
+    for (size_t i = 0; i < queue->capacity; i++)
+        atomic_init(slot_seq(queue, i), i);
+
+    return 0;
+}
+
+void mpsc_destroy(struct mpsc_queue* queue) {
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+int mpsc_push(struct mpsc_queue* queue, const void* elem) {
+    size_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    while (1) {
+        size_t seq = atomic_load_explicit(slot_seq(queue, pos), memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // The consumer hasn't freed this slot yet.
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+
+    memcpy(slot_data(queue, pos), elem, queue->elem_size);
+    atomic_store_explicit(slot_seq(queue, pos), pos + 1, memory_order_release);
+
+    // Producers only read `waiting`, so while the consumer is busy they share that line instead of
+    // fighting over it. The fence pairs with the one in mpsc_wait: either we see the consumer
+    // waiting, or it sees this element before it sleeps.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->waiting, memory_order_relaxed)) {
+        atomic_fetch_add(&queue->wakeups, 1);
+        syscall(SYS_futex, &queue->wakeups, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+
+    return 0;
+}
+
+size_t mpsc_pop_batch(struct mpsc_queue* queue, void* out, size_t max) {
+    size_t count = 0;
+
+    while (count < max) {
+        size_t pos = queue->tail;
+        if (atomic_load_explicit(slot_seq(queue, pos), memory_order_acquire) != pos + 1)
+            break;
+
+        memcpy((char*)out + count * queue->elem_size, slot_data(queue, pos), queue->elem_size);
+        atomic_store_explicit(slot_seq(queue, pos), pos + queue->capacity, memory_order_release);
+
+        queue->tail++;
+        count++;
+    }
+
+    return count;
+}
+
+static int mpsc_ready(struct mpsc_queue* queue) {
+    return atomic_load_explicit(slot_seq(queue, queue->tail), memory_order_acquire) == queue->tail + 1;
+}
+
+int mpsc_wait(struct mpsc_queue* queue, int timeout_ms) {
+    u64 deadline = timeout_ms < 0 ? 0 : time_ms() + timeout_ms;
+
+    while (!mpsc_ready(queue)) {
+        // Announce that we're about to sleep before taking one last look, so a push that lands
+        // in between either gets seen here or changes `wakeups` and cuts the sleep short.
+        atomic_store(&queue->waiting, 1);
+        u32 seen = atomic_load(&queue->wakeups);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        if (mpsc_ready(queue))
+            break;
+
+        struct timespec timeout, *timeout_ptr = NULL;
+        if (deadline) {
+            u64 now = time_ms();
+            if (now >= deadline) {
+                atomic_store(&queue->waiting, 0);
+                return -1;
+            }
+
+            timeout.tv_sec = (deadline - now) / 1000;
+            timeout.tv_nsec = (long)((deadline - now) % 1000) * 1000000;
+            timeout_ptr = &timeout;
+        }
+
+        syscall(SYS_futex, &queue->wakeups, FUTEX_WAIT_PRIVATE, seen, timeout_ptr, NULL, 0);
+    }
+
+    atomic_store(&queue->waiting, 0);
+    return 0;
+}
\ No newline at end of file
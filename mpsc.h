@@ -0,0 +1,40 @@
+#ifndef _MPSC_H
+#define _MPSC_H
+
+#include "util.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Bounded lock-free queue with any number of producers and a single consumer. Elements are
+// fixed size and copied in and out. Nothing here takes a lock; a consumer waiting on an empty
+// queue sleeps on a futex that producers only poke when someone is actually waiting.
+struct mpsc_queue {
+    // Claimed by producers with a CAS. Each index gets its own cache line so producers and the
+    // consumer don't bounce each other's lines around.
+    _Alignas(64) _Atomic size_t head;
+    // Only touched by the consumer.
+    _Alignas(64) size_t tail;
+    // Bumped by a push that finds the consumer waiting, the consumer sleeps on it.
+    _Alignas(64) _Atomic u32 wakeups;
+    _Atomic int waiting;
+
+    _Alignas(64) size_t capacity, mask;
+    size_t elem_size, stride;
+    char* slots;
+};
+
+// Capacity is rounded up to a power of two. Returns -1 if the slots can't be allocated.
+int mpsc_init(struct mpsc_queue* queue, size_t capacity, size_t elem_size);
+void mpsc_destroy(struct mpsc_queue* queue);
+
+// Copies elem into the queue. Returns -1 if the queue is full.
+int mpsc_push(struct mpsc_queue* queue, const void* elem);
+
+// Copies up to max elements into out and returns how many were taken. Consumer only.
+size_t mpsc_pop_batch(struct mpsc_queue* queue, void* out, size_t max);
+
+// Waits until there's something to pop. Returns -1 if timeout_ms passes first, negative waits
+// forever. Consumer only.
+int mpsc_wait(struct mpsc_queue* queue, int timeout_ms);
+
+#endif
\ No newline at end of file
@@ -1,10 +1,8 @@
 #include "network.h"
 #include "packet.h"
+#include "trace.h"
+#include <errno.h>
 #include <string.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netdb.h>
-#include <unistd.h>
 
 #include <stdarg.h>
 #include <stdio.h>
@@ -23,6 +21,11 @@ static char* pack_u32(char* ptr, u32 num) {
     return ptr + 4;
 }
 
+static char* pack_u64(char* ptr, u64 num) {
+    ptr = pack_u32(ptr, (u32)(num >> 32));
+    return pack_u32(ptr, (u32)num);
+}
+
 static char* pack_header(char* ptr, struct packet_header* header) {
     *ptr = (char)(header->type);
     return pack_u16(ptr + 1, (uint16_t)(header->length));
@@ -41,11 +44,249 @@ static char* unpack_u32(char* ptr, u32* num) {
     return ptr + 4;
 }
 
+static char* unpack_u64(char* ptr, u64* num) {
+    u32 high, low;
+    ptr = unpack_u32(ptr, &high);
+    ptr = unpack_u32(ptr, &low);
+    *num = ((u64)high << 32) | low;
+    return ptr;
+}
+
 static char* unpack_header(char* ptr, struct packet_header* header) {
     header->type = (enum packet_type)*ptr;
     return unpack_u16(ptr + 1, &header->length);
 }
 
+static char* pack_move_result(char* ptr, struct pkt_move_result* result) {
+    *ptr++ = (u8)result->result;
+    *ptr++ = (u8)result->ship_type;
+    *ptr++ = (u8)result->ship_row;
+    *ptr++ = (u8)result->ship_col;
+    *ptr++ = (u8)result->ship_dir;
+    *ptr++ = (u8)result->ship_size;
+    *ptr++ = (u8)result->win;
+    return ptr;
+}
+
+// Compact results (NET_CAP_COMPACT): bits 0-1 of the first byte are the result and bit 2 is set on
+// the winning shot. Only a sink carries ship data, two more bytes: the index of the ship's first
+// square, then its type with the direction in bit 3. The size follows from the type.
+#define COMPACT_WIN 0x04
+#define COMPACT_DIR 0x08
+
+static char* pack_compact_result(char* ptr, struct pkt_move_result* result) {
+    *ptr++ = (u8)(result->result | (result->win ? COMPACT_WIN : 0));
+    if (result->result == NET_SINK) {
+        *ptr++ = (u8)(result->ship_row * BOARD_SIZE + result->ship_col);
+        *ptr++ = (u8)(result->ship_type | (result->ship_dir ? COMPACT_DIR : 0));
+    }
+    return ptr;
+}
+
+#define MOVE_RESULT_LENGTH 7
+
+// Compact moves are a single byte, the index of the square.
+static int move_length(struct connection* conn) {
+    return conn->capabilities & NET_CAP_COMPACT ? 1 : 2;
+}
+
+static char* pack_move(struct connection* conn, char* ptr, const struct pkt_move* move) {
+    if (conn->capabilities & NET_CAP_COMPACT) {
+        *ptr++ = (u8)(move->row * BOARD_SIZE + move->col);
+    } else {
+        *ptr++ = (u8)move->row;
+        *ptr++ = (u8)move->col;
+    }
+    return ptr;
+}
+
+// Reads a move from the packet body. Returns -1 and disconnects the peer if it's invalid.
+static int unpack_move(struct connection* conn, char* ptr, struct pkt_move* move) {
+    int row, col;
+    if (conn->capabilities & NET_CAP_COMPACT) {
+        int square = (u8)ptr[0];
+        row = square < BOARD_SIZE * BOARD_SIZE ? square / BOARD_SIZE : -1;
+        col = square % BOARD_SIZE;
+    } else {
+        row = (int)ptr[0];
+        col = (int)ptr[1];
+    }
+    if (row < 0 || row >= BOARD_SIZE || col < 0 || col >= BOARD_SIZE) {
+        disconnectf(conn, "protocol error: invalid coordinates in move packet");
+        return -1;
+    }
+
+    move->row = row;
+    move->col = col;
+    return 0;
+}
+
+// Reads a move result from the packet body. Returns -1 and disconnects the peer if it's invalid.
+static int unpack_move_result(struct connection* conn, char* ptr, struct pkt_move_result* move_result) {
+    enum net_move_result result = (enum net_move_result)*ptr;
+    switch (result) {
+    case NET_HIT:
+    case NET_MISS:
+    case NET_SINK:
+        break;
+    default:
+        disconnectf(conn, "protocol error: invalid result in move result packet");
+        return -1;
+    }
+
+    enum ship ship_type = (enum ship)ptr[1];
+    switch (ship_type) {
+    case SHIP_NONE:
+    case AIRCRAFT_CARRIER:
+    case BATTLESHIP:
+    case CRUISER:
+    case SUBMARINE:
+    case DESTROYER:
+        break;
+    default:
+        disconnectf(conn, "protocol error: invalid ship_type in move result packet");
+        return -1;
+    }
+
+    int r = (int)ptr[2], 
+        c = (int)ptr[3], 
+        dir = (int)ptr[4], 
+        ship_size = (int)ptr[5], 
+        win = (int)ptr[6];
+
+    if (r < 0 || c < 0 || r >= BOARD_SIZE || c >= BOARD_SIZE) {
+        disconnectf(conn, "protocol error: invalid ship pos for move result: %i %i", r, c);
+        return -1;
+    }
+
+    if ((dir && (r + ship_size > BOARD_SIZE))
+        || (!dir && (c + ship_size > BOARD_SIZE))) {
+        disconnectf(conn, "protocol error: ship for move result exceeds bounds: %i %i %i %i", r, c, dir, ship_size);
+        return -1;
+    }
+
+    move_result->result = result;
+    move_result->ship_type = ship_type;
+    move_result->ship_row = r;
+    move_result->ship_col = c;
+    move_result->ship_dir = dir;
+    move_result->ship_size = ship_size;
+    move_result->win = win;
+    return 0;
+}
+
+// Reads a compact move result from the first `length` bytes of `ptr`. Returns the number of bytes
+// it took, or -1 and disconnects the peer if it's invalid.
+static int unpack_compact_result(struct connection* conn, char* ptr, int length, struct pkt_move_result* move_result) {
+    if (length < 1) {
+        disconnectf(conn, "protocol error: truncated move result");
+        return -1;
+    }
+
+    u8 flags = (u8)ptr[0];
+    enum net_move_result result = (enum net_move_result)(flags & 0x03);
+    if ((flags & ~(0x03 | COMPACT_WIN)) || (result != NET_HIT && result != NET_MISS && result != NET_SINK)) {
+        disconnectf(conn, "protocol error: invalid result in move result packet");
+        return -1;
+    }
+
+    *move_result = (struct pkt_move_result){ .result = result, .win = (flags & COMPACT_WIN) != 0 };
+    if (result != NET_SINK)
+        return 1;
+
+    if (length < 3) {
+        disconnectf(conn, "protocol error: truncated move result");
+        return -1;
+    }
+
+    int square = (u8)ptr[1];
+    u8 type = (u8)ptr[2];
+    enum ship ship_type = (enum ship)(type & ~COMPACT_DIR);
+    if (ship_type <= SHIP_NONE || ship_type >= SHIP_COUNT || (type & ~(COMPACT_DIR | 0x07))) {
+        disconnectf(conn, "protocol error: invalid ship_type in move result packet");
+        return -1;
+    }
+
+    int r = square / BOARD_SIZE,
+        c = square % BOARD_SIZE,
+        dir = (type & COMPACT_DIR) != 0,
+        size = ship_size(ship_type);
+
+    if (square >= BOARD_SIZE * BOARD_SIZE
+        || (dir && r + size > BOARD_SIZE)
+        || (!dir && c + size > BOARD_SIZE)) {
+        disconnectf(conn, "protocol error: ship for move result exceeds bounds: %i %i %i %i", r, c, dir, size);
+        return -1;
+    }
+
+    move_result->ship_type = ship_type;
+    move_result->ship_row = r;
+    move_result->ship_col = c;
+    move_result->ship_dir = dir;
+    move_result->ship_size = size;
+    return 3;
+}
+
+// Reads a hello packet body. Peers from before game modes existed only send the magic, and version 1
+// peers stop after the mode. Version 2 peers may follow the capabilities with a name (length
+// first) and a rating store id. Anything after that is left for later versions.
+static int unpack_hello(struct connection* conn, char* ptr, u16 length, struct pkt_hello* hello) {
+    if (length != 4 && length != 5 && length < 8) {
+        disconnectf(conn, "protocol error: bad hello length: %i", length);
+        return -1;
+    }
+
+    u32 magic;
+    ptr = unpack_u32(ptr, &magic);
+    if (magic != NET_MAGIC) {
+        disconnectf(conn, "protocol error: bad magic");
+        return -1;
+    }
+
+    hello->mode = MODE_CLASSIC;
+    hello->version = 1;
+    hello->capabilities = 0;
+    hello->name[0] = '\0';
+    hello->ratings_id = 0;
+    if (length >= 5) {
+        hello->mode = (enum game_mode)*ptr++;
+        if (hello->mode != MODE_CLASSIC && hello->mode != MODE_SALVO) {
+            disconnectf(conn, "protocol error: invalid game mode in hello: %i", hello->mode);
+            return -1;
+        }
+    }
+
+    if (length >= 8) {
+        hello->version = (u8)*ptr++;
+        ptr = unpack_u16(ptr, &hello->capabilities);
+        if (hello->version < 2) {
+            disconnectf(conn, "protocol error: invalid version in hello: %i", hello->version);
+            return -1;
+        }
+    }
+
+    if (length > 8) {
+        u8 name_length = (u8)*ptr++;
+        if (name_length >= NET_NAME_LENGTH || length < 17 + name_length) {
+            disconnectf(conn, "protocol error: bad name length in hello: %i", name_length);
+            return -1;
+        }
+
+        // Names end up in files and on screen, so only printable ASCII.
+        for (int i = 0; i < name_length; i++) {
+            if (ptr[i] < ' ' || ptr[i] > '~') {
+                disconnectf(conn, "protocol error: invalid name in hello");
+                return -1;
+            }
+        }
+        memcpy(hello->name, ptr, name_length);
+        hello->name[name_length] = '\0';
+        unpack_u64(ptr + name_length, &hello->ratings_id);
+    }
+
+    return 0;
+}
+
 void disconnectf(struct connection* conn, const char* fmt, ...) {
     if (conn->is_disconnected)
         return;
@@ -70,7 +311,46 @@ void disconnectf(struct connection* conn, const char* fmt, ...) {
 
 #define PACKET_MAX_LENGTH 512
 
+// Makes sure at least `length` bytes are buffered. Returns the number of bytes buffered if the
+// peer closed the connection first, or -1 on a socket error or once `deadline` (in time_ms())
+// passes. A deadline of 0 waits forever.
+static ssize_t fill_buffer(struct connection* conn, size_t length, u64 deadline) {
+    if (conn->rend - conn->rstart >= length)
+        return (ssize_t)length;
+
+    // Move the leftovers to the front so there's room for a whole packet.
+    if (conn->rstart > 0) {
+        memmove(conn->rbuf, conn->rbuf + conn->rstart, conn->rend - conn->rstart);
+        conn->rend -= conn->rstart;
+        conn->rstart = 0;
+    }
+
+    while (conn->rend < length) {
+        int timeout_ms = -1;
+        if (deadline) {
+            u64 now = time_ms();
+            if (now >= deadline) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            timeout_ms = (int)(deadline - now);
+        }
+
+        ssize_t status = conn->transport->recv(conn, conn->rbuf + conn->rend, RECV_BUFFER_SIZE - conn->rend, timeout_ms);
+        if (status < 0)
+            return -1;
+        if (status == 0)
+            return (ssize_t)conn->rend;
+
+        conn->rend += status;
+    }
+
+    return (ssize_t)length;
+}
+
 void send_packet(struct connection *conn, struct packet *pkt) {
+    TRACE_SCOPE("send_packet");
+
     struct packet_header header = { .type = pkt->type };
 
     char buf[3 + PACKET_MAX_LENGTH];
@@ -80,6 +360,21 @@ void send_packet(struct connection *conn, struct packet *pkt) {
     case PKT_SERVER_HELLO:
     case PKT_CLIENT_HELLO:
         body = pack_u32(body, NET_MAGIC);
+        // Peers from before game modes only accept the bare magic. They all play classic, so the
+        // mode is only sent for salvo, or when a version has to follow it.
+        if (pkt->hello.mode != MODE_CLASSIC || pkt->hello.version >= 2)
+            *body++ = (u8)pkt->hello.mode;
+        // Version 1 peers reject a hello any longer than five bytes.
+        if (pkt->hello.version >= 2) {
+            *body++ = (u8)pkt->hello.version;
+            body = pack_u16(body, pkt->hello.capabilities);
+        }
+        if (pkt->hello.version >= 2 && (pkt->hello.name[0] || pkt->hello.ratings_id)) {
+            size_t length = strnlen(pkt->hello.name, NET_NAME_LENGTH - 1);
+            *body++ = (char)length;
+            memcpy(body, pkt->hello.name, length);
+            body = pack_u64(body + length, pkt->hello.ratings_id);
+        }
         break;
     case PKT_SERVER_READY:
     case PKT_SHIPS_READY:
@@ -93,17 +388,27 @@ void send_packet(struct connection *conn, struct packet *pkt) {
         *body++ = (u8)pkt->begin_game.first;
         break;
     case PKT_MOVE:
-        *body++ = (u8)pkt->move.row;
-        *body++ = (u8)pkt->move.col;
+        body = pack_move(conn, body, &pkt->move);
         break;
     case PKT_MOVE_RESULT:
-        *body++ = (u8)pkt->move_result.result;
-        *body++ = (u8)pkt->move_result.ship_type;
-        *body++ = (u8)pkt->move_result.ship_row;
-        *body++ = (u8)pkt->move_result.ship_col;
-        *body++ = (u8)pkt->move_result.ship_dir;
-        *body++ = (u8)pkt->move_result.ship_size;
-        *body++ = (u8)pkt->move_result.win;
+        if (conn->capabilities & NET_CAP_COMPACT)
+            body = pack_compact_result(body, &pkt->move_result);
+        else
+            body = pack_move_result(body, &pkt->move_result);
+        break;
+    case PKT_SALVO:
+        *body++ = (u8)pkt->salvo.count;
+        for (int i = 0; i < pkt->salvo.count; i++)
+            body = pack_move(conn, body, &pkt->salvo.shots[i]);
+        break;
+    case PKT_SALVO_RESULT:
+        *body++ = (u8)pkt->salvo_result.count;
+        for (int i = 0; i < pkt->salvo_result.count; i++) {
+            if (conn->capabilities & NET_CAP_COMPACT)
+                body = pack_compact_result(body, &pkt->salvo_result.results[i]);
+            else
+                body = pack_move_result(body, &pkt->salvo_result.results[i]);
+        }
         break;
     default:
         fprintf(stderr, "TODO: Packet type %i\n", pkt->type);
@@ -112,18 +417,68 @@ void send_packet(struct connection *conn, struct packet *pkt) {
 
     header.length = body - buf - 3;
     pack_header(buf, &header);
-    send(conn->fd, buf, header.length + 3, 0);
+
+    size_t sent = 0, total = header.length + 3;
+    while (sent < total) {
+        ssize_t status = conn->transport->send(conn, buf + sent, total - sent);
+        if (status < 0) {
+            perror("send error");
+            return;
+        }
+        sent += status;
+    }
+}
+
+static int packet_type_valid(enum packet_type type) {
+    return type >= PKT_CLIENT_HELLO && type <= PKT_SALVO_RESULT;
+}
+
+// Takes a token for one incoming packet. Returns -1 if the peer is over its limit.
+static int take_rate_token(struct connection* conn) {
+    if (conn->rate_limit <= 0)
+        return 0;
+
+    u64 now = time_ms();
+    if (conn->rate_refilled_ms == 0) {
+        conn->rate_tokens = conn->rate_burst;
+        conn->rate_refilled_ms = now;
+    }
+
+    // Only whole tokens are added, the leftover time carries over to the next refill.
+    u64 earned = (now - conn->rate_refilled_ms) * conn->rate_limit / 1000;
+    if (earned > 0) {
+        conn->rate_tokens = earned >= (u64)conn->rate_burst ? conn->rate_burst : conn->rate_tokens + (int)earned;
+        if (conn->rate_tokens > conn->rate_burst)
+            conn->rate_tokens = conn->rate_burst;
+        conn->rate_refilled_ms += earned * 1000 / conn->rate_limit;
+    }
+
+    if (conn->rate_tokens <= 0)
+        return -1;
+
+    conn->rate_tokens--;
+    return 0;
 }
 
 int recv_packet(struct connection* conn, struct packet* pkt) {
+    TRACE_SCOPE("recv_packet");
     ssize_t recv_status;
 
-    char buf[3 + PACKET_MAX_LENGTH];
-    if ((recv_status = recv(conn->fd, buf, 3, 0)) < 3) {
+    // Nothing a peer sends after being disconnected is worth reading.
+    if (conn->is_disconnected)
+        return -1;
+
+    u64 deadline = conn->timeout_ms > 0 ? time_ms() + conn->timeout_ms : 0;
+
+    if ((recv_status = fill_buffer(conn, 3, deadline)) < 3) {
         if (recv_status == 0) {
             fprintf(stderr, "error: The connection was closed.\n");
             return -1;
         }
+        if (recv_status < 0 && errno == ETIMEDOUT) {
+            disconnectf(conn, "timed out after %i seconds", conn->timeout_ms / 1000);
+            return -1;
+        }
         if (recv_status < 0) {
             perror("recv error");
             return -1;
@@ -133,25 +488,43 @@ int recv_packet(struct connection* conn, struct packet* pkt) {
     }
 
     struct packet_header header;
-    unpack_header(buf, &header);
+    unpack_header(conn->rbuf + conn->rstart, &header);
+
+    // Reject what we can from the header alone, before waiting on or decoding the body.
+    if (take_rate_token(conn)) {
+        disconnectf(conn, "sending packets too fast");
+        return -1;
+    }
+
+    if (!packet_type_valid(header.type)) {
+        disconnectf(conn, "protocol error: bad packet type: %i", header.type);
+        return -1;
+    }
 
     if (header.length > PACKET_MAX_LENGTH) {
         disconnectf(conn, "protocol error: packet too long");
         return -1;
     }
 
-    char* body = buf + 3;
     if (header.length > 0) {
-        if ((recv_status = recv(conn->fd, body, header.length, 0)) < header.length) {
+        if ((recv_status = fill_buffer(conn, 3 + header.length, deadline)) < 3 + header.length) {
+            if (recv_status < 0 && errno == ETIMEDOUT) {
+                disconnectf(conn, "timed out after %i seconds", conn->timeout_ms / 1000);
+                return -1;
+            }
             if (recv_status < 0) {
                 perror("recv error");
                 return -1;
             }
-            disconnectf(conn, "protocol error: didn't get all the bytes (%i of %i)", (int)recv_status, header.length);
+            disconnectf(conn, "protocol error: didn't get all the bytes (%i of %i)", (int)recv_status - 3, header.length);
             return -1;
         }
     }
 
+    // The packet is parsed straight out of the receive buffer.
+    char* body = conn->rbuf + conn->rstart + 3;
+    conn->rstart += 3 + header.length;
+
 #define EXPECT_LENGTH(elength, name)                                                     \
     if (header.length != (elength)) {                                                    \
         disconnectf(conn, "protocol error: bad " name " length: %i", header.length);    \
@@ -160,26 +533,11 @@ int recv_packet(struct connection* conn, struct packet* pkt) {
 
 
     switch (header.type) {
-    case PKT_CLIENT_HELLO: {
-        EXPECT_LENGTH(4, "client hello");
-
-        u32 magic;
-        unpack_u32(body, &magic);
-        if (magic != NET_MAGIC) {
-            disconnectf(conn, "protocol error: bad magic");
-            return -1;
-        }
-    } break;
-    case PKT_SERVER_HELLO: {
-        EXPECT_LENGTH(4, "server hello");
-
-        u32 magic;
-        unpack_u32(body, &magic);
-        if (magic != NET_MAGIC) {
-            disconnectf(conn, "protocol error: bad magic");
+    case PKT_CLIENT_HELLO:
+    case PKT_SERVER_HELLO:
+        if (unpack_hello(conn, body, header.length, &pkt->hello))
             return -1;
-        }
-    } break;
+        break;
     case PKT_SERVER_READY:
         EXPECT_LENGTH(0, "server ready");
         break;
@@ -194,7 +552,9 @@ int recv_packet(struct connection* conn, struct packet* pkt) {
         }
 
         // TODO: Maybe, just maybe, we should sanitize the string
-        strncpy(pkt->disconnect.reason, body, 511);
+        // The body isn't null terminated, and the next packet may already be sitting right after it.
+        memcpy(pkt->disconnect.reason, body, header.length);
+        pkt->disconnect.reason[header.length] = '\0';
         break;
     case PKT_BEGIN_GAME: {
         EXPECT_LENGTH(1, "begin game");
@@ -207,71 +567,66 @@ int recv_packet(struct connection* conn, struct packet* pkt) {
 
         pkt->begin_game.first = first;
     } break;
-    case PKT_MOVE: {
-        EXPECT_LENGTH(2, "move");
+    case PKT_MOVE:
+        EXPECT_LENGTH(move_length(conn), "move");
 
-        int row = (int)body[0];
-        int col = (int)body[1];
-        if (row < 0 || row >= BOARD_SIZE || col < 0 || col >= BOARD_SIZE) {
-            disconnectf(conn, "protocol error: invalid coordinates in move packet");
+        if (unpack_move(conn, body, &pkt->move))
             return -1;
-        }
-
-        pkt->move.row = row;
-        pkt->move.col = col;
-    } break;
-    case PKT_MOVE_RESULT: {
-        EXPECT_LENGTH(7, "move result");
-        
-        enum net_move_result result = (enum net_move_result)*body;
-        switch (result) {
-        case NET_HIT:
-        case NET_MISS:
-        case NET_SINK:
-            break;
-        default:
-            disconnectf(conn, "protocol error: invalid result in move result packet");
-            return -1;
-        }
-
-        enum ship ship_type = (enum ship)body[1];
-        switch (ship_type) {
-        case SHIP_NONE:
-        case AIRCRAFT_CARRIER:
-        case BATTLESHIP:
-        case CRUISER:
-        case SUBMARINE:
-        case DESTROYER:
+        break;
+    case PKT_MOVE_RESULT:
+        if (conn->capabilities & NET_CAP_COMPACT) {
+            // The length depends on the result, so the whole body has to be used up.
+            if (unpack_compact_result(conn, body, header.length, &pkt->move_result) != header.length) {
+                disconnectf(conn, "protocol error: bad move result length: %i", header.length);
+                return -1;
+            }
             break;
-        default:
-            disconnectf(conn, "protocol error: invalid ship_type in move result packet");
-            return -1;
         }
 
-        int r = (int)body[2], 
-            c = (int)body[3], 
-            dir = (int)body[4], 
-            ship_size = (int)body[5], 
-            win = (int)body[6];
+        EXPECT_LENGTH(MOVE_RESULT_LENGTH, "move result");
 
-        if (r < 0 || c < 0 || r >= BOARD_SIZE || c >= BOARD_SIZE) {
-            disconnectf(conn, "protocol error: invalid ship pos for move result: %i %i", r, c);
+        if (unpack_move_result(conn, body, &pkt->move_result))
+            return -1;
+        break;
+    case PKT_SALVO: {
+        int count = header.length > 0 ? (u8)body[0] : 0;
+        if (count < 1 || count > SALVO_MAX_SHOTS) {
+            disconnectf(conn, "protocol error: bad shot count in salvo: %i", count);
             return -1;
         }
+        EXPECT_LENGTH(1 + move_length(conn) * count, "salvo");
 
-        if ((dir && (r + ship_size > BOARD_SIZE))
-            || (!dir && (c + ship_size > BOARD_SIZE))) {
-            disconnectf(conn, "protocol error: ship for move result exceeds bounds: %i %i %i %i", r, c, dir, ship_size);
+        pkt->salvo.count = count;
+        for (int i = 0; i < count; i++) {
+            if (unpack_move(conn, body + 1 + move_length(conn) * i, &pkt->salvo.shots[i]))
+                return -1;
+        }
+    } break;
+    case PKT_SALVO_RESULT: {
+        int count = header.length > 0 ? (u8)body[0] : 0;
+        if (count < 1 || count > SALVO_MAX_SHOTS) {
+            disconnectf(conn, "protocol error: bad result count in salvo result: %i", count);
             return -1;
         }
+        pkt->salvo_result.count = count;
+        if (conn->capabilities & NET_CAP_COMPACT) {
+            int offset = 1;
+            for (int i = 0; i < count; i++) {
+                int used = unpack_compact_result(conn, body + offset, header.length - offset, &pkt->salvo_result.results[i]);
+                if (used < 0)
+                    return -1;
+                offset += used;
+            }
+            EXPECT_LENGTH(offset, "salvo result");
+            break;
+        }
 
-        pkt->move_result.result = result;
-        pkt->move_result.ship_type = ship_type;
-        pkt->move_result.ship_row = r;
-        pkt->move_result.ship_col = c;
-        pkt->move_result.ship_dir = dir;
-        pkt->move_result.ship_size = ship_size;
-        pkt->move_result.win = win;
+        EXPECT_LENGTH(1 + MOVE_RESULT_LENGTH * count, "salvo result");
+
+        for (int i = 0; i < count; i++) {
+            if (unpack_move_result(conn, body + 1 + MOVE_RESULT_LENGTH * i, &pkt->salvo_result.results[i]))
+                return -1;
+        }
     } break;
     default:
         disconnectf(conn, "protocol error: bad packet type: %i", header.type);
@@ -282,6 +637,26 @@ int recv_packet(struct connection* conn, struct packet* pkt) {
     return 0;
 }
 
+void connection_set_timeout(struct connection* conn, int timeout_ms) {
+    conn->timeout_ms = timeout_ms;
+}
+
+void connection_set_rate_limit(struct connection* conn, int per_second, int burst) {
+    conn->rate_limit = per_second;
+    conn->rate_burst = burst;
+    conn->rate_tokens = burst;
+    conn->rate_refilled_ms = 0;
+}
+
+void connection_set_protocol(struct connection* conn, int version, u16 capabilities) {
+    conn->version = version;
+    conn->capabilities = capabilities;
+}
+
+void connection_close(struct connection* conn) {
+    conn->transport->close(conn);
+}
+
 /* int net_get_header(int fd, struct packet_header* header) {
     char buf[3];
     if (recv(fd, buf, 3, 0) < 3)
@@ -2,13 +2,48 @@
 #define _NETWORK_H
 
 #include "packet.h"
+#include <stddef.h>
+
+#include <sys/types.h>
+
+#define RECV_BUFFER_SIZE 4096
+
+struct connection;
+
+// Moves raw bytes between peers. Packets are encoded and validated above this, so every
+// transport goes through the same protocol code. See transport.h for the backends.
+struct transport {
+    // Same contract as send()/recv(): returns the number of bytes moved, 0 if the peer closed
+    // the connection (recv only), or -1 on error. recv gives up with ETIMEDOUT after timeout_ms,
+    // or waits forever if it's negative.
+    ssize_t (*send)(struct connection* conn, const void* buf, size_t length);
+    ssize_t (*recv)(struct connection* conn, void* buf, size_t length, int timeout_ms);
+    void (*close)(struct connection* conn);
+};
 
 struct connection {
     // Are we the server or the client?
     enum peer_type type;
     // 1 if we've disconnected
     int is_disconnected;
+    // How long recv_packet() waits for a packet before disconnecting the peer. 0 waits forever.
+    int timeout_ms;
+    // Token bucket limiting how many packets per second the peer may send. 0 means no limit.
+    int rate_limit, rate_burst;
+    int rate_tokens;
+    u64 rate_refilled_ms;
+    // Protocol version and capabilities agreed on in the hello. Packets use the version 1
+    // encoding until connection_set_protocol() is called.
+    int version;
+    u16 capabilities;
+    const struct transport* transport;
+    // Socket for the TCP transport, backend state for the others.
     int fd;
+    void* impl;
+    // Bytes received but not yet parsed, in rbuf[rstart..rend). Each recv() grabs as much as
+    // the socket has, so back-to-back packets only cost one syscall.
+    char rbuf[RECV_BUFFER_SIZE];
+    size_t rstart, rend;
 };
 
 void disconnectf(struct connection* conn, const char* fmt, ...);
@@ -16,4 +51,9 @@ void disconnectf(struct connection* conn, const char* fmt, ...);
 void send_packet(struct connection* conn, struct packet* pkt);
 int recv_packet(struct connection* conn, struct packet* pkt);
 
+void connection_set_timeout(struct connection* conn, int timeout_ms);
+void connection_set_rate_limit(struct connection* conn, int per_second, int burst);
+void connection_set_protocol(struct connection* conn, int version, u16 capabilities);
+void connection_close(struct connection* conn);
+
 #endif
\ No newline at end of file
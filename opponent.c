@@ -0,0 +1,228 @@
+#include "opponent.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+// Snapshot layout, in native byte order: magic, version, entry count, then the entries as they
+// sit in memory.
+#define OPPONENT_MAGIC "BSOP"
+#define OPPONENT_VERSION 1
+
+// How many games of evidence it takes to pull the prior halfway away from uniform.
+#define PRIOR_STRENGTH 4.0f
+
+static u32 hash_name(const char* name) {
+    u32 hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ (u8)*name) * 16777619u;
+    return hash;
+}
+
+static struct opponent_entry* find_slot(struct opponent_entry* entries, size_t capacity, const char* name) {
+    size_t idx = hash_name(name) & (capacity - 1);
+    while (entries[idx].name[0] && strcmp(entries[idx].name, name) != 0)
+        idx = (idx + 1) & (capacity - 1);
+    return &entries[idx];
+}
+
+static int grow(struct opponent_store* store) {
+    size_t capacity = store->capacity ? store->capacity * 2 : 64;
+    struct opponent_entry* entries = calloc(capacity, sizeof(struct opponent_entry));
+    if (!entries)
+        return -1;
+
+    for (size_t i = 0; i < store->capacity; i++) {
+        if (store->entries[i].name[0])
+            *find_slot(entries, capacity, store->entries[i].name) = store->entries[i];
+    }
+
+    free(store->entries);
+    store->entries = entries;
+    store->capacity = capacity;
+    return 0;
+}
+
+struct opponent_history* opponent_store_get(struct opponent_store* store, const char* name, int create) {
+    if (!*name)
+        return NULL;
+
+    if (store->capacity) {
+        struct opponent_entry* entry = find_slot(store->entries, store->capacity, name);
+        if (entry->name[0])
+            return &entry->history;
+    }
+
+    if (!create)
+        return NULL;
+
+    // Keep the table at most 3/4 full so probes stay short.
+    if ((store->count + 1) * 4 > store->capacity * 3 && grow(store))
+        return NULL;
+
+    struct opponent_entry* entry = find_slot(store->entries, store->capacity, name);
+    memset(entry, 0, sizeof *entry);
+    snprintf(entry->name, OPPONENT_NAME_LENGTH, "%s", name);
+    store->count++;
+    return &entry->history;
+}
+
+int opponent_store_load(struct opponent_store* store, const char* path) {
+    memset(store, 0, sizeof *store);
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    char magic[4];
+    u32 version, count;
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, OPPONENT_MAGIC, 4) != 0
+        || fread(&version, sizeof version, 1, file) != 1 || version != OPPONENT_VERSION
+        || fread(&count, sizeof count, 1, file) != 1)
+        goto corrupt;
+
+    for (u32 i = 0; i < count; i++) {
+        struct opponent_entry entry;
+        if (fread(&entry, sizeof entry, 1, file) != 1)
+            goto corrupt;
+
+        entry.name[OPPONENT_NAME_LENGTH - 1] = '\0';
+        struct opponent_history* history = opponent_store_get(store, entry.name, 1);
+        if (!history)
+            goto corrupt;
+        *history = entry.history;
+    }
+
+    fclose(file);
+    return 0;
+
+corrupt:
+    fprintf(stderr, "%s is not a valid opponent file\n", path);
+    fclose(file);
+    opponent_store_free(store);
+    return -1;
+}
+
+int opponent_store_save(struct opponent_store* store, const char* path) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof tmp_path, "%s.tmp", path);
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) {
+        perror("opponent file error");
+        return -1;
+    }
+
+    u32 version = OPPONENT_VERSION, count = (u32)store->count;
+    int status = 0;
+    status |= fwrite(OPPONENT_MAGIC, 1, 4, file) != 4;
+    status |= fwrite(&version, sizeof version, 1, file) != 1;
+    status |= fwrite(&count, sizeof count, 1, file) != 1;
+
+    for (size_t i = 0; i < store->capacity; i++) {
+        if (store->entries[i].name[0])
+            status |= fwrite(&store->entries[i], sizeof(struct opponent_entry), 1, file) != 1;
+    }
+
+    status |= fclose(file) != 0;
+
+    // Write then rename, so a crash never leaves a half written snapshot behind.
+    if (status || rename(tmp_path, path) < 0) {
+        perror("opponent file write error");
+        remove(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+int opponent_store_record(const char* path, const char* name, struct their_board* board) {
+    if (!*name)
+        return 0;
+
+    // Saving replaces the snapshot with a new file, so the lock lives on one that stays put.
+    char lock_path[4096];
+    snprintf(lock_path, sizeof lock_path, "%s.lock", path);
+    int lock = open(lock_path, O_RDWR | O_CREAT, 0644);
+    if (lock < 0) {
+        perror("opponent lock error");
+        return -1;
+    }
+
+    int status;
+    while ((status = flock(lock, LOCK_EX)) < 0 && errno == EINTR);
+    if (status < 0) {
+        perror("opponent lock error");
+        close(lock);
+        return -1;
+    }
+
+    struct opponent_store store;
+    status = opponent_store_load(&store, path);
+    if (status == 0) {
+        struct opponent_history* history = opponent_store_get(&store, name, 1);
+        if (history) {
+            opponent_record_game(history, board);
+            status = opponent_store_save(&store, path);
+        } else {
+            status = -1;
+        }
+        opponent_store_free(&store);
+    }
+
+    // Closing drops the lock.
+    close(lock);
+    return status;
+}
+
+void opponent_store_free(struct opponent_store* store) {
+    free(store->entries);
+    memset(store, 0, sizeof *store);
+}
+
+void opponent_record_game(struct opponent_history* history, struct their_board* board) {
+    // Halve everything before the counters overflow. This also lets recent games count for more.
+    if (history->games == UINT16_MAX) {
+        history->games /= 2;
+        for (int r = 0; r < BOARD_SIZE; r++) {
+            for (int c = 0; c < BOARD_SIZE; c++)
+                history->occupied[r][c] /= 2;
+        }
+    }
+
+    history->games++;
+
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        struct placed_ship* sunk = &board->sunk[ship];
+        for (int i = 0; i < sunk->size; i++) {
+            int r = sunk->row + (sunk->dir ? i : 0);
+            int c = sunk->col + (sunk->dir ? 0 : i);
+            history->occupied[r][c]++;
+        }
+    }
+}
+
+void opponent_prior(const struct opponent_history* history, struct placement_prior* prior) {
+    // Smoothed rate of each square being covered, starting from a uniform guess.
+    float uniform = 17.0f / (BOARD_SIZE * BOARD_SIZE);
+    float total = 0;
+
+    for (int r = 0; r < BOARD_SIZE; r++) {
+        for (int c = 0; c < BOARD_SIZE; c++) {
+            float rate = (history->occupied[r][c] + PRIOR_STRENGTH * uniform) / (history->games + PRIOR_STRENGTH);
+            prior->scale[r][c] = rate;
+            total += rate;
+        }
+    }
+
+    // Scale so the average square is 1. Only where they like to put ships matters, not how many
+    // of their ships we managed to see.
+    float mean = total / (BOARD_SIZE * BOARD_SIZE);
+    for (int r = 0; r < BOARD_SIZE; r++) {
+        for (int c = 0; c < BOARD_SIZE; c++)
+            prior->scale[r][c] /= mean;
+    }
+}
\ No newline at end of file
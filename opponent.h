@@ -0,0 +1,46 @@
+#ifndef _OPPONENT_H
+#define _OPPONENT_H
+
+#include "ai.h"
+#include "util.h"
+#include <stddef.h>
+
+#define OPPONENT_NAME_LENGTH 64
+
+// Where one opponent has put their ships in past games, as far as we've seen them: only ships
+// we sank are revealed.
+struct opponent_history {
+    u16 games;
+    u16 occupied[BOARD_SIZE][BOARD_SIZE];
+};
+
+struct opponent_entry {
+    char name[OPPONENT_NAME_LENGTH];
+    struct opponent_history history;
+};
+
+// Open addressing hash table from opponent name to history, backed by a snapshot file.
+struct opponent_store {
+    struct opponent_entry* entries;
+    size_t count, capacity;
+};
+
+// Loads a snapshot. A missing file just gives an empty store. Returns -1 on a corrupt file.
+int opponent_store_load(struct opponent_store* store, const char* path);
+// Replaces the snapshot with the store's contents. Returns -1 on failure.
+int opponent_store_save(struct opponent_store* store, const char* path);
+// Adds a finished game against `name` to the snapshot at path. The file is locked and read again
+// first, so games finished by other processes sharing it aren't lost. Returns -1 on failure.
+int opponent_store_record(const char* path, const char* name, struct their_board* board);
+void opponent_store_free(struct opponent_store* store);
+
+// Finds an opponent's history, adding an empty one if `create` is set. Returns NULL if not found.
+struct opponent_history* opponent_store_get(struct opponent_store* store, const char* name, int create);
+
+// Adds the ships revealed in a finished game.
+void opponent_record_game(struct opponent_history* history, struct their_board* board);
+
+// Turns a history into per-square scales for the AI's heat map.
+void opponent_prior(const struct opponent_history* history, struct placement_prior* prior);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "optimize.h"
+#include "layout.h"
+#include "sim.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Temperatures in shots: early on a step that costs the AI a couple fewer shots is often taken,
+// by the end almost never.
+#define START_TEMPERATURE 2.0
+#define END_TEMPERATURE 0.02
+
+struct optimize_job {
+    struct optimize_options* options;
+    struct layout_pool* pool;
+    // Next annealing run to hand out.
+    _Atomic int next;
+};
+
+// Average shots the strategy needs to sink the fleet. Every candidate in a run is scored against
+// the same seeds, so differences between them come from the fleet and not the dice.
+static double evaluate(const struct strategy* strategy, const struct fleet* fleet, u64 seed, int games) {
+    struct our_board board;
+    if (fleet_unpack(fleet, &board))
+        return -1;
+
+    int shots = 0;
+    for (int g = 0; g < games; g++) {
+        struct rng rng;
+        rng_seed(&rng, seed + g);
+        int game = sim_shots_to_win(&board, strategy, &rng);
+        if (game < 0)
+            return -1;
+        shots += game;
+    }
+
+    return (double)shots / games;
+}
+
+// Moves one ship somewhere legal. Mostly small nudges, sometimes a jump anywhere.
+static void neighbor(const struct fleet* from, struct fleet* to, struct rng* rng) {
+    while (1) {
+        *to = *from;
+        struct packed_ship* ship = &to->ships[rng_range(rng, SHIP_COUNT - 1)];
+
+        switch (rng_range(rng, 4)) {
+        case 0:
+            ship->row += rng_range(rng, 2) ? 1 : -1;
+            break;
+        case 1:
+            ship->col += rng_range(rng, 2) ? 1 : -1;
+            break;
+        case 2:
+            ship->dir = !ship->dir;
+            break;
+        default:
+            ship->row = (u8)rng_range(rng, BOARD_SIZE);
+            ship->col = (u8)rng_range(rng, BOARD_SIZE);
+            ship->dir = (u8)rng_range(rng, 2);
+            break;
+        }
+
+        // Stepping off the top or left wraps around to 255, which fleet_validate rejects.
+        if (fleet_validate(to) == 0)
+            return;
+    }
+}
+
+static void anneal(struct optimize_options* options, u64 seed, struct fleet* best, float* best_score) {
+    struct rng rng;
+    rng_seed(&rng, seed);
+
+    struct our_board board;
+    board_init_random(&board, &rng);
+
+    struct fleet current, candidate;
+    fleet_pack(&board, &current);
+    double current_score = evaluate(options->strategy, &current, seed, options->games);
+
+    *best = current;
+    *best_score = (float)current_score;
+
+    for (int i = 0; i < options->iterations; i++) {
+        double t = START_TEMPERATURE * pow(END_TEMPERATURE / START_TEMPERATURE, (double)i / options->iterations);
+
+        neighbor(&current, &candidate, &rng);
+        double score = evaluate(options->strategy, &candidate, seed, options->games);
+
+        // We want more shots, so a higher score is always taken and a lower one sometimes.
+        if (score >= current_score || rng_double(&rng) < exp((score - current_score) / t)) {
+            current = candidate;
+            current_score = score;
+
+            if (score > *best_score) {
+                *best = current;
+                *best_score = (float)score;
+            }
+        }
+    }
+}
+
+static void* worker(void* arg) {
+    struct optimize_job* job = arg;
+    int run;
+
+    while ((run = atomic_fetch_add(&job->next, 1)) < job->options->layouts) {
+        u64 seed = job->options->seed + (u64)run * 1000003;
+        anneal(job->options, seed, &job->pool->fleets[run], &job->pool->scores[run]);
+
+        // The best score of a run is flattered by the noise it was picked for, so score the
+        // winner again on games it hasn't seen.
+        job->pool->scores[run] = (float)evaluate(job->options->strategy, &job->pool->fleets[run], ~seed, 4 * job->options->games);
+        fprintf(stderr, "layout %i: %.2f shots\n", run + 1, job->pool->scores[run]);
+    }
+
+    return NULL;
+}
+
+int optimize(const char* pool_path, struct optimize_options* options) {
+    struct layout_pool pool = {
+        .count = options->layouts,
+        .fleets = calloc(options->layouts, sizeof(struct fleet)),
+        .scores = calloc(options->layouts, sizeof(float))
+    };
+    if (!pool.fleets || !pool.scores) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    int threads = options->threads < 1 ? 1 : options->threads;
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    struct optimize_job job = { .options = options, .pool = &pool };
+    atomic_init(&job.next, 0);
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, worker, &job);
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    free(tids);
+
+    // Compare against random fleets scored the same way.
+    struct rng rng;
+    rng_seed(&rng, options->seed ^ 0xBA117E);
+    double baseline = 0, pooled = 0;
+    for (int i = 0; i < options->layouts; i++) {
+        struct our_board board;
+        struct fleet fleet;
+        board_init_random(&board, &rng);
+        fleet_pack(&board, &fleet);
+        baseline += evaluate(options->strategy, &fleet, options->seed + i, options->games);
+        pooled += pool.scores[i];
+    }
+
+    printf("%i layouts: %.2f shots to sink on average, against %.2f for random fleets\n",
+        options->layouts, pooled / options->layouts, baseline / options->layouts);
+
+    int status = layout_pool_save(&pool, pool_path);
+    layout_pool_free(&pool);
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef _OPTIMIZE_H
+#define _OPTIMIZE_H
+
+#include "strategy.h"
+
+struct optimize_options {
+    // How many fleets to put in the pool. Each one is its own annealing run.
+    int layouts;
+    // Annealing steps per run.
+    int iterations;
+    // Simulated games used to score each candidate fleet.
+    int games;
+    int threads;
+    u64 seed;
+    // Who the fleets have to hold out against.
+    const struct strategy* strategy;
+};
+
+// Searches for fleets the strategy needs the most shots to sink, using simulated annealing on several
+// threads, and writes them to a layout pool. Returns -1 on failure.
+int optimize(const char* pool_path, struct optimize_options* options);
+
+#endif
\ No newline at end of file
@@ -19,6 +19,9 @@ enum packet_type {
     PKT_MOVE_RESULT,    // Result of a move (hit, miss, ship sunk)
 
     PKT_DISCONNECT,     // Sent when an error is encountered.
+
+    PKT_SALVO,          // Player has fired a salvo (salvo mode only)
+    PKT_SALVO_RESULT,   // Results of every shot in a salvo
 };
 
 enum peer_type {
@@ -40,6 +43,43 @@ struct packet_header {
 // weak attempt at writing BATTLE in hex
 #define NET_MAGIC 0x00BA117E
 
+// The newest protocol version we speak. Version 1 peers only send the magic and the mode in their
+// hello; from version 2 on the hello also carries a version and a set of capabilities, and may go
+// on to say who the player is.
+#define NET_VERSION 2
+
+// Optional protocol features. A feature is only used if both peers offer it in their hello.
+enum net_capability {
+    // Moves are one byte (the square's index) and results are one byte, plus two more on a sink.
+    NET_CAP_COMPACT = 1 << 0,
+};
+
+// Everything this build supports.
+#define NET_CAPABILITIES NET_CAP_COMPACT
+
+// Longest player name a hello carries, including the terminator.
+#define NET_NAME_LENGTH 64
+
+enum game_mode {
+    MODE_CLASSIC,   // One shot per turn
+    MODE_SALVO      // One shot per surviving ship per turn
+};
+
+struct pkt_hello {
+    // The client sends the mode it wants to play, the server replies with the mode that will be played.
+    // Peers that don't send a mode are treated as classic.
+    enum game_mode mode;
+    // The client sends the newest version and the capabilities it supports, the server replies
+    // with the version and capabilities both sides will use. Version 1 peers send neither.
+    int version;
+    u16 capabilities;
+    // Who the player is, so ratings and opponent history follow them rather than their address,
+    // and which rating store they record results in (see rating_store_identity(), 0 for none).
+    // Only sent from version 2 on, and then only if there's a name or a store.
+    char name[NET_NAME_LENGTH];
+    u64 ratings_id;
+};
+
 struct pkt_begin_game {
     // Who will go first.
     enum peer_type first;  
@@ -58,6 +98,20 @@ struct pkt_move_result {
     u8 win;
 };
 
+// A salvo has at most one shot per ship.
+#define SALVO_MAX_SHOTS (SHIP_COUNT - 1)
+
+struct pkt_salvo {
+    int count;
+    struct pkt_move shots[SALVO_MAX_SHOTS];
+};
+
+struct pkt_salvo_result {
+    // One result per shot, in the same order as the salvo.
+    int count;
+    struct pkt_move_result results[SALVO_MAX_SHOTS];
+};
+
 struct pkt_end_game {
     enum peer_type winner;
 };
@@ -69,9 +123,12 @@ struct pkt_disconnect {
 struct packet {
     enum packet_type type;
     union {
+        struct pkt_hello hello;
         struct pkt_begin_game begin_game;
         struct pkt_move move;
         struct pkt_move_result move_result;
+        struct pkt_salvo salvo;
+        struct pkt_salvo_result salvo_result;
         struct pkt_end_game end_game;
         struct pkt_disconnect disconnect;
     };
@@ -1,12 +1,11 @@
 #include "player.h"
 #include "util.h"
-#include <assert.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Read a board coordinate from stdin. Returns 1 if failed, 0 if succeeded.
+// Read a board coordinate from stdin. Returns -1 if failed, 1 if the line was blank, 0 if succeeded.
 int player_get_coord(int* r, int* c) {
     char* line = NULL;
     size_t size = 0;
@@ -14,6 +13,11 @@ int player_get_coord(int* r, int* c) {
     if (getline(&line, &size, stdin) < 0)
         goto invalid;
 
+    if (strcmp(line, "\n") == 0) {
+        free(line);
+        return 1;
+    }
+
     char col;
     int row;
 
@@ -74,65 +78,6 @@ invalid:
     return 1;
 }
 
-static int has_ship(struct our_board* board, int r, int c) {
-    if (r >= BOARD_SIZE || c >= BOARD_SIZE || r < 0 || c < 0)
-        return 0;
-    
-    if (board->ships[r][c] != SHIP_NONE)
-        return 1;
-
-    return 0;
-}
-
-static int ship_obstructed(struct our_board* board, int r, int c, int dir, int size) {
-    int cur_row = r, cur_col = c;
-    
-    for (int i = 0; i < size; i++) {
-        if (cur_row >= BOARD_SIZE || cur_col >= BOARD_SIZE)
-            return 1;
-
-        if (board->ships[cur_row][cur_col] != SHIP_NONE)
-            return 1;
-
-        // Check four neighboring squares to make sure there isn't a ship there either.
-        if (has_ship(board, cur_row - 1, cur_col)
-            || has_ship(board, cur_row + 1, cur_col)
-            || has_ship(board, cur_row, cur_col - 1)
-            || has_ship(board, cur_row, cur_col + 1))
-            return 1;
-
-        if (dir)
-            cur_row++;
-        else
-            cur_col++;
-    }
-    
-    return 0;
-}
-
-static void place_ship(struct our_board* board, enum ship ship, int r, int c, int dir, int size) {
-    board->placements[ship] = (struct placed_ship){
-        .row = r,
-        .col = c,
-        .dir = dir,
-        .size = size,
-        .count = size
-    };
-
-    board->ship_count++;
-    
-    for (int i = 0; i < size; i++) {
-        assert(board->ships[r][c] == SHIP_NONE);
-
-        board->ships[r][c] = ship;
-
-        if (dir)
-            r++;
-        else
-            c++;
-    }
-}
-
 static void player_place_ship(struct our_board* board, enum ship ship, int size) {
     ourboard_print(board);
 
@@ -182,58 +127,18 @@ static void player_place_ship(struct our_board* board, enum ship ship, int size)
     place_ship(board, ship, r, c, dir, size);
 }
 
-static void place_ship_random(struct our_board* board, enum ship ship, int size) {
-    int obstructed_table[BOARD_SIZE][BOARD_SIZE][2];
-    int unobstructed_count = 0;
-
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            for (int k = 0; k < 2; k++) {
-                int obstructed = ship_obstructed(board, i, j, k, size);
-                obstructed_table[i][j][k] = obstructed;
-
-                if (!obstructed) {
-                    unobstructed_count++;
-                }
-            }
-        }
-    }
-
-    int idx = rand() % unobstructed_count;
-    int counter = 0;
-
-    int r = 0, c = 0, dir = 0;
-    int placed = 0;
-
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            for (int k = 0; k < 2; k++) {
-                if (!obstructed_table[i][j][k] && idx == counter++) {
-                    placed = 1;
-
-                    r = i;
-                    c = j;
-                    dir = k;
-                }
-            }
-        }
+void player_create_board(struct our_board *board, struct layout_pool* pool) {
+    static struct rng rng;
+    static int seeded;
+    if (!seeded) {
+        rng_seed(&rng, (u64)rand());
+        seeded = 1;
     }
 
-    assert(placed);
-    place_ship(board, ship, r, c, dir, size);
-}
-
-static void board_init_random(struct our_board* board) {
-    ourboard_init(board);
-    place_ship_random(board, AIRCRAFT_CARRIER, 5);
-    place_ship_random(board, BATTLESHIP, 4);
-    place_ship_random(board, CRUISER, 3);
-    place_ship_random(board, SUBMARINE, 3);
-    place_ship_random(board, DESTROYER, 2);
-}
-
-void player_create_board(struct our_board *board) {
-    board_init_random(board);
+    if (pool)
+        layout_pool_sample(pool, &rng, board);
+    else
+        board_init_random(board, &rng);
     ourboard_print(board);
     printf("Your ships have been arranged randomly. Is this okay? (y/n) ");
 
@@ -2,8 +2,10 @@
 #define _PLAYER_H
 
 #include "board.h"
+#include "layout.h"
 
 int player_get_coord(int* r, int* c);
-void player_create_board(struct our_board* board);
+// Offers a random fleet (from the pool, if there is one) and lets the player place their own instead.
+void player_create_board(struct our_board* board, struct layout_pool* pool);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,607 @@
+#include "rating.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Snapshot layout, in native byte order: magic, version, generation, player count, then the
+// players best first as they sit in memory. The log is magic, version and generation, then a
+// copy of each player as it was after every change; the latest copy wins. A log only belongs to
+// the snapshot with the same generation, anything else is already part of the snapshot.
+#define SNAPSHOT_MAGIC "BSRT"
+#define LOG_MAGIC "BSRL"
+#define RATING_VERSION 1
+#define LOG_HEADER_LENGTH 12
+
+// How far one game can move a rating.
+#define K_FACTOR 32.0f
+// The log is compacted once it holds this many records plus a quarter as many as there are
+// players. Replaying the log is much slower than loading a snapshot, so it's kept short.
+#define MIN_COMPACT_RECORDS 4096
+// Keeps every table size and the hash table's 4/3 headroom within a u32.
+#define MAX_PLAYERS (1u << 30)
+
+static u32 hash_name(const char* name) {
+    u32 hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ (u8)*name) * 16777619u;
+    return hash;
+}
+
+// Treap priorities are a hash of the node, so they don't need storing and a snapshot can be
+// turned back into the same tree.
+static u32 priority(u32 node) {
+    u32 x = node * 0x9E3779B1u;
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    return x;
+}
+
+// 1 if node a ranks above node b. Ties go to whoever was added first.
+static int before(struct rating_store* store, u32 a, u32 b) {
+    float ra = store->players[a - 1].rating, rb = store->players[b - 1].rating;
+    return ra > rb || (ra == rb && a < b);
+}
+
+static void update_size(struct rating_store* store, u32 t) {
+    store->size[t] = 1 + store->size[store->left[t]] + store->size[store->right[t]];
+}
+
+// Splits t into the nodes that rank above key and the rest.
+static void split(struct rating_store* store, u32 t, u32 key, u32* l, u32* r) {
+    if (!t) {
+        *l = *r = 0;
+        return;
+    }
+
+    if (before(store, t, key)) {
+        split(store, store->right[t], key, &store->right[t], r);
+        *l = t;
+    } else {
+        split(store, store->left[t], key, l, &store->left[t]);
+        *r = t;
+    }
+    update_size(store, t);
+}
+
+static u32 merge(struct rating_store* store, u32 a, u32 b) {
+    if (!a || !b)
+        return a ? a : b;
+
+    if (priority(a) > priority(b)) {
+        store->right[a] = merge(store, store->right[a], b);
+        update_size(store, a);
+        return a;
+    }
+
+    store->left[b] = merge(store, a, store->left[b]);
+    update_size(store, b);
+    return b;
+}
+
+static u32 insert(struct rating_store* store, u32 t, u32 node) {
+    if (!t)
+        return node;
+
+    if (priority(node) > priority(t)) {
+        split(store, t, node, &store->left[node], &store->right[node]);
+        update_size(store, node);
+        return node;
+    }
+
+    if (before(store, node, t))
+        store->left[t] = insert(store, store->left[t], node);
+    else
+        store->right[t] = insert(store, store->right[t], node);
+    update_size(store, t);
+    return t;
+}
+
+static u32 erase(struct rating_store* store, u32 t, u32 node) {
+    if (t == node)
+        return merge(store, store->left[t], store->right[t]);
+
+    if (before(store, node, t))
+        store->left[t] = erase(store, store->left[t], node);
+    else
+        store->right[t] = erase(store, store->right[t], node);
+    update_size(store, t);
+    return t;
+}
+
+static void collect(struct rating_store* store, u32 t, int k, const struct rating_player** out, int* n) {
+    if (!t || *n >= k)
+        return;
+
+    collect(store, store->left[t], k, out, n);
+    if (*n < k)
+        out[(*n)++] = &store->players[t - 1];
+    collect(store, store->right[t], k, out, n);
+}
+
+static u32* find_slot(u32* slots, u32 capacity, struct rating_player* players, const char* name) {
+    u32 idx = hash_name(name) & (capacity - 1);
+    while (slots[idx] && strcmp(players[slots[idx] - 1].name, name) != 0)
+        idx = (idx + 1) & (capacity - 1);
+    return &slots[idx];
+}
+
+static int reserve(struct rating_store* store, u32 count) {
+    if (count > MAX_PLAYERS)
+        return -1;
+
+    if (count > store->capacity) {
+        u32 capacity = store->capacity ? store->capacity : 1024;
+        while (capacity < count)
+            capacity *= 2;
+
+        struct rating_player* players = realloc(store->players, capacity * sizeof(struct rating_player));
+        if (players)
+            store->players = players;
+        u32* left = realloc(store->left, (capacity + 1) * sizeof(u32));
+        if (left)
+            store->left = left;
+        u32* right = realloc(store->right, (capacity + 1) * sizeof(u32));
+        if (right)
+            store->right = right;
+        u32* size = realloc(store->size, (capacity + 1) * sizeof(u32));
+        if (size)
+            store->size = size;
+        if (!players || !left || !right || !size)
+            return -1;
+
+        store->capacity = capacity;
+        store->size[0] = 0;
+    }
+
+    // Keep the table at most 3/4 full so probes stay short.
+    if ((u64)count * 4 > (u64)store->slot_capacity * 3) {
+        u32 capacity = store->slot_capacity ? store->slot_capacity : 2048;
+        while ((u64)count * 4 > (u64)capacity * 3)
+            capacity *= 2;
+
+        u32* slots = calloc(capacity, sizeof(u32));
+        if (!slots)
+            return -1;
+        for (u32 i = 0; i < store->count; i++)
+            *find_slot(slots, capacity, store->players, store->players[i].name) = i + 1;
+
+        free(store->slots);
+        store->slots = slots;
+        store->slot_capacity = capacity;
+    }
+
+    return 0;
+}
+
+// Returns the player's node, adding them at the initial rating if needed. 0 if out of memory.
+static u32 get_node(struct rating_store* store, const char* name) {
+    if (store->slot_capacity) {
+        u32 node = *find_slot(store->slots, store->slot_capacity, store->players, name);
+        if (node)
+            return node;
+    }
+
+    if (reserve(store, store->count + 1))
+        return 0;
+
+    u32 node = ++store->count;
+    struct rating_player* player = &store->players[node - 1];
+    memset(player, 0, sizeof *player);
+    snprintf(player->name, RATING_NAME_LENGTH, "%s", name);
+    player->rating = RATING_INITIAL;
+
+    store->left[node] = store->right[node] = 0;
+    store->size[node] = 1;
+    store->root = insert(store, store->root, node);
+    *find_slot(store->slots, store->slot_capacity, store->players, player->name) = node;
+    return node;
+}
+
+static void set_rating(struct rating_store* store, u32 node, float rating, u32 games) {
+    store->root = erase(store, store->root, node);
+    store->players[node - 1].rating = rating;
+    store->players[node - 1].games = games;
+    store->left[node] = store->right[node] = 0;
+    store->size[node] = 1;
+    store->root = insert(store, store->root, node);
+}
+
+// Rebuilds the tree from players already in rank order in O(n): the treap for fixed priorities
+// is the Cartesian tree of the sequence, built left to right with a stack of the right spine.
+static int build_sorted(struct rating_store* store) {
+    u32* stack = malloc((store->count + 1) * sizeof(u32));
+    if (!stack)
+        return -1;
+
+    u32 depth = 0;
+    for (u32 node = 1; node <= store->count; node++) {
+        u32 last = 0;
+        while (depth && priority(stack[depth - 1]) < priority(node)) {
+            last = stack[--depth];
+            update_size(store, last);
+        }
+
+        store->left[node] = last;
+        store->right[node] = 0;
+        if (depth)
+            store->right[stack[depth - 1]] = node;
+        stack[depth++] = node;
+    }
+
+    store->root = depth ? stack[0] : 0;
+    while (depth)
+        update_size(store, stack[--depth]);
+
+    free(stack);
+    return 0;
+}
+
+static int load_snapshot(struct rating_store* store) {
+    store->count = 0;
+    store->root = 0;
+    if (store->slots)
+        memset(store->slots, 0, store->slot_capacity * sizeof(u32));
+    store->generation = 0;
+
+    FILE* file = fopen(store->path, "rb");
+    if (!file)
+        return 0;
+
+    // The count is checked against the file's size before anything is allocated for it.
+    struct stat st;
+    char magic[4];
+    u32 version, generation, count;
+    if (fstat(fileno(file), &st) || fread(magic, 1, 4, file) != 4 || memcmp(magic, SNAPSHOT_MAGIC, 4) != 0
+        || fread(&version, sizeof version, 1, file) != 1 || version != RATING_VERSION
+        || fread(&generation, sizeof generation, 1, file) != 1
+        || fread(&count, sizeof count, 1, file) != 1
+        || (u64)count * sizeof(struct rating_player) > (u64)st.st_size - 16
+        || reserve(store, count)
+        || fread(store->players, sizeof(struct rating_player), count, file) != count)
+        goto corrupt;
+
+    fclose(file);
+
+    int sorted = 1;
+    for (u32 i = 0; i < count; i++) {
+        store->players[i].name[RATING_NAME_LENGTH - 1] = '\0';
+        u32* slot = find_slot(store->slots, store->slot_capacity, store->players, store->players[i].name);
+        if (*slot || isnan(store->players[i].rating))
+            goto corrupt_closed;
+        *slot = i + 1;
+
+        store->count = i + 1;
+        if (i > 0 && !before(store, i, i + 1))
+            sorted = 0;
+    }
+
+    store->generation = generation;
+
+    // Snapshots are written in rank order, so this only falls back to inserting one by one if
+    // the file was produced by something else.
+    if (sorted)
+        return build_sorted(store);
+
+    for (u32 node = 1; node <= count; node++) {
+        store->left[node] = store->right[node] = 0;
+        store->size[node] = 1;
+        store->root = insert(store, store->root, node);
+    }
+    return 0;
+
+corrupt:
+    fclose(file);
+corrupt_closed:
+    fprintf(stderr, "%s is not a valid rating file\n", store->path);
+    store->count = 0;
+    store->root = 0;
+    return -1;
+}
+
+// Empties the log and stamps it with the current generation.
+static int reset_log(struct rating_store* store) {
+    u8 header[LOG_HEADER_LENGTH];
+    u32 version = RATING_VERSION;
+    memcpy(header, LOG_MAGIC, 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &store->generation, 4);
+
+    if (ftruncate(store->log_fd, 0) || pwrite(store->log_fd, header, sizeof header, 0) != sizeof header) {
+        perror("rating log error");
+        return -1;
+    }
+
+    store->log_offset = LOG_HEADER_LENGTH;
+    store->log_records = 0;
+    return 0;
+}
+
+// Applies whatever was appended to the log since we last looked. The caller holds the file lock.
+static int read_log(struct rating_store* store) {
+    struct stat st;
+    if (fstat(store->log_fd, &st)) {
+        perror("rating log error");
+        return -1;
+    }
+
+    u64 available = (u64)st.st_size > store->log_offset ? (u64)st.st_size - store->log_offset : 0;
+    u64 records = available / sizeof(struct rating_player);
+    if (records == 0)
+        return 0;
+
+    struct rating_player* buf = malloc(records * sizeof(struct rating_player));
+    if (!buf || pread(store->log_fd, buf, records * sizeof(struct rating_player), (off_t)store->log_offset)
+                    != (ssize_t)(records * sizeof(struct rating_player))) {
+        perror("rating log error");
+        free(buf);
+        return -1;
+    }
+
+    for (u64 i = 0; i < records; i++) {
+        buf[i].name[RATING_NAME_LENGTH - 1] = '\0';
+        if (!buf[i].name[0] || isnan(buf[i].rating))
+            continue;
+
+        u32 node = get_node(store, buf[i].name);
+        if (!node) {
+            free(buf);
+            return -1;
+        }
+        set_rating(store, node, buf[i].rating, buf[i].games);
+    }
+
+    free(buf);
+    store->log_offset += records * sizeof(struct rating_player);
+    store->log_records += (u32)records;
+
+    // A writer that died mid record leaves a partial one at the end. Drop it so our appends
+    // stay aligned.
+    if ((u64)st.st_size > store->log_offset && ftruncate(store->log_fd, (off_t)store->log_offset)) {
+        perror("rating log error");
+        return -1;
+    }
+    return 0;
+}
+
+static int reload(struct rating_store* store) {
+    if (load_snapshot(store))
+        return -1;
+
+    u8 header[LOG_HEADER_LENGTH];
+    u32 version, generation;
+    if (pread(store->log_fd, header, sizeof header, 0) != sizeof header)
+        return reset_log(store);
+
+    memcpy(&version, header + 4, 4);
+    memcpy(&generation, header + 8, 4);
+    if (memcmp(header, LOG_MAGIC, 4) != 0 || version != RATING_VERSION || generation != store->generation)
+        return reset_log(store);
+
+    store->log_offset = LOG_HEADER_LENGTH;
+    store->log_records = 0;
+    return read_log(store);
+}
+
+// Brings the store up to date with the files. The caller holds the file lock.
+static int catch_up(struct rating_store* store) {
+    u8 header[LOG_HEADER_LENGTH];
+    u32 generation;
+
+    // Someone else compacted since we last looked, so start over from their snapshot.
+    if (pread(store->log_fd, header, sizeof header, 0) != sizeof header)
+        return reload(store);
+    memcpy(&generation, header + 8, 4);
+    if (generation != store->generation)
+        return reload(store);
+
+    return read_log(store);
+}
+
+static int compact(struct rating_store* store) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof tmp_path, "%s.tmp", store->path);
+
+    const struct rating_player** order = malloc((store->count + 1) * sizeof(struct rating_player*));
+    FILE* file = order ? fopen(tmp_path, "wb") : NULL;
+    if (!file) {
+        perror("rating file error");
+        free(order);
+        return -1;
+    }
+
+    int n = 0;
+    collect(store, store->root, (int)store->count, order, &n);
+
+    u32 version = RATING_VERSION, generation = store->generation + 1, count = store->count;
+    int status = 0;
+    status |= fwrite(SNAPSHOT_MAGIC, 1, 4, file) != 4;
+    status |= fwrite(&version, sizeof version, 1, file) != 1;
+    status |= fwrite(&generation, sizeof generation, 1, file) != 1;
+    status |= fwrite(&count, sizeof count, 1, file) != 1;
+    for (int i = 0; i < n; i++)
+        status |= fwrite(order[i], sizeof(struct rating_player), 1, file) != 1;
+    status |= fclose(file) != 0;
+    free(order);
+
+    // Write then rename, so a crash never leaves a half written snapshot behind. Until the log
+    // is reset its generation no longer matches, so nothing in it is applied twice.
+    if (status || rename(tmp_path, store->path) < 0) {
+        perror("rating file write error");
+        remove(tmp_path);
+        return -1;
+    }
+
+    store->generation = generation;
+    return reset_log(store);
+}
+
+int rating_store_open(struct rating_store* store, const char* path) {
+    memset(store, 0, sizeof *store);
+    pthread_mutex_init(&store->lock, NULL);
+
+    char log_path[4096];
+    snprintf(log_path, sizeof log_path, "%s.log", path);
+
+    store->path = strdup(path);
+    store->log_fd = open(log_path, O_RDWR | O_CREAT, 0644);
+    if (!store->path || store->log_fd < 0) {
+        perror("rating log error");
+        rating_store_close(store);
+        return -1;
+    }
+
+    flock(store->log_fd, LOCK_EX);
+    int status = reload(store);
+    flock(store->log_fd, LOCK_UN);
+
+    if (status)
+        rating_store_close(store);
+    return status;
+}
+
+u64 rating_store_identity(const char* path) {
+    char log_path[4096];
+    snprintf(log_path, sizeof log_path, "%s.log", path);
+
+    // The log is created on open anyway, and unlike the snapshot it's never replaced, so its
+    // inode stays the same for the life of the store.
+    int fd = open(log_path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    close(fd);
+
+    char host[256] = {0};
+    gethostname(host, sizeof host - 1);
+
+    u64 hash = 14695981039346656037ull;
+    for (const char* c = host; *c; c++)
+        hash = (hash ^ (u8)*c) * 1099511628211ull;
+    u64 parts[2] = { (u64)st.st_dev, (u64)st.st_ino };
+    for (int i = 0; i < 2; i++)
+        for (int b = 0; b < 8; b++)
+            hash = (hash ^ ((parts[i] >> (b * 8)) & 0xFF)) * 1099511628211ull;
+    return hash ? hash : 1;
+}
+
+void rating_store_close(struct rating_store* store) {
+    if (store->log_fd >= 0)
+        close(store->log_fd);
+    free(store->path);
+    free(store->players);
+    free(store->left);
+    free(store->right);
+    free(store->size);
+    free(store->slots);
+    pthread_mutex_destroy(&store->lock);
+    memset(store, 0, sizeof *store);
+}
+
+int rating_store_record(struct rating_store* store, const struct rating_game* games, int count) {
+    struct rating_player* changed = malloc(2 * (size_t)count * sizeof(struct rating_player));
+    if (!changed)
+        return -1;
+
+    pthread_mutex_lock(&store->lock);
+    flock(store->log_fd, LOCK_EX);
+
+    int status = catch_up(store);
+    int n = 0;
+
+    for (int i = 0; i < count && status == 0; i++) {
+        char winner_name[RATING_NAME_LENGTH], loser_name[RATING_NAME_LENGTH];
+        snprintf(winner_name, sizeof winner_name, "%s", games[i].winner ? games[i].winner : "");
+        snprintf(loser_name, sizeof loser_name, "%s", games[i].loser ? games[i].loser : "");
+        if (!winner_name[0] || !loser_name[0] || strcmp(winner_name, loser_name) == 0)
+            continue;
+
+        u32 winner = get_node(store, winner_name);
+        u32 loser = get_node(store, loser_name);
+        if (!winner || !loser) {
+            status = -1;
+            break;
+        }
+
+        struct rating_player* w = &store->players[winner - 1];
+        struct rating_player* l = &store->players[loser - 1];
+        float expected = 1.0f / (1.0f + powf(10.0f, (l->rating - w->rating) / 400.0f));
+        float delta = K_FACTOR * (1.0f - expected);
+
+        set_rating(store, winner, w->rating + delta, w->games + 1);
+        set_rating(store, loser, l->rating - delta, l->games + 1);
+        changed[n++] = store->players[winner - 1];
+        changed[n++] = store->players[loser - 1];
+    }
+
+    if (status == 0 && n > 0) {
+        size_t bytes = (size_t)n * sizeof(struct rating_player);
+        if (pwrite(store->log_fd, changed, bytes, (off_t)store->log_offset) != (ssize_t)bytes) {
+            perror("rating log error");
+            status = -1;
+        } else {
+            store->log_offset += bytes;
+            store->log_records += n;
+        }
+    }
+
+    if (status == 0 && store->log_records > MIN_COMPACT_RECORDS + store->count / 4)
+        status = compact(store);
+
+    flock(store->log_fd, LOCK_UN);
+    pthread_mutex_unlock(&store->lock);
+    free(changed);
+    return status;
+}
+
+const struct rating_player* rating_store_find(struct rating_store* store, const char* name, u32* rank) {
+    char key[RATING_NAME_LENGTH];
+    snprintf(key, sizeof key, "%s", name);
+
+    pthread_mutex_lock(&store->lock);
+    // Other processes may have recorded games since we last looked. If the files can't be read,
+    // answer from what we already have.
+    flock(store->log_fd, LOCK_EX);
+    catch_up(store);
+    flock(store->log_fd, LOCK_UN);
+
+    const struct rating_player* player = NULL;
+    u32 node = store->slot_capacity ? *find_slot(store->slots, store->slot_capacity, store->players, key) : 0;
+    if (node) {
+        player = &store->players[node - 1];
+
+        // Count everyone ranked above on the way down.
+        u32 above = 0, t = store->root;
+        while (t && t != node) {
+            if (before(store, node, t)) {
+                t = store->left[t];
+            } else {
+                above += store->size[store->left[t]] + 1;
+                t = store->right[t];
+            }
+        }
+        *rank = above + store->size[store->left[node]] + 1;
+    }
+
+    pthread_mutex_unlock(&store->lock);
+    return player;
+}
+
+int rating_store_top(struct rating_store* store, int k, const struct rating_player** out) {
+    int n = 0;
+    pthread_mutex_lock(&store->lock);
+    flock(store->log_fd, LOCK_EX);
+    catch_up(store);
+    flock(store->log_fd, LOCK_UN);
+    collect(store, store->root, k, out, &n);
+    pthread_mutex_unlock(&store->lock);
+    return n;
+}
\ No newline at end of file
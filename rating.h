@@ -0,0 +1,70 @@
+#ifndef _RATING_H
+#define _RATING_H
+
+#include "util.h"
+#include <pthread.h>
+#include <stddef.h>
+
+#define RATING_NAME_LENGTH 64
+#define RATING_INITIAL 1500.0f
+
+struct rating_player {
+    char name[RATING_NAME_LENGTH];
+    float rating;
+    u32 games;
+};
+
+struct rating_game {
+    const char* winner;
+    const char* loser;
+};
+
+// Elo ratings for every player, with a hash table from name to player and a treap ordered best
+// first (with subtree sizes) so ranks and top-K lists take O(log n). Backed by a snapshot at
+// `path`, kept in rank order so it loads in one pass, and an append-only log of changed players
+// at `path.log`. Several processes can share a store: updates lock the log, catch up on whatever
+// the others appended, then append their own.
+struct rating_store {
+    char* path;
+    pthread_mutex_t lock;
+
+    struct rating_player* players;
+    u32 count, capacity;
+
+    // Treap links for player i live at i + 1, 0 is the empty tree.
+    u32* left;
+    u32* right;
+    u32* size;
+    u32 root;
+
+    // Open addressing from name to player index + 1, 0 for an empty slot.
+    u32* slots;
+    u32 slot_capacity;
+
+    int log_fd;
+    // How far into the log we've applied, and which snapshot the log belongs to.
+    u64 log_offset;
+    u32 generation;
+    u32 log_records;
+};
+
+// Loads the snapshot and log, creating them if needed. Returns -1 on failure.
+int rating_store_open(struct rating_store* store, const char* path);
+void rating_store_close(struct rating_store* store);
+// Identifies the files behind the store at `path` (by host and inode), creating them if needed, so
+// two players can tell whether they record to the same store. 0 if it can't be opened.
+u64 rating_store_identity(const char* path);
+
+// Applies finished games in order and appends the changed players to the log in one write, and
+// compacts the log into a new snapshot once it gets long. Safe to call from
+// several threads. Returns -1 on failure.
+int rating_store_record(struct rating_store* store, const struct rating_game* games, int count);
+
+// Both queries first catch up on games other processes have recorded in the files. Finds a player
+// and their rank (1 is best), or returns NULL if they have never played. Pointers from either are
+// valid until the next update or query.
+const struct rating_player* rating_store_find(struct rating_store* store, const char* name, u32* rank);
+// Fills `out` with up to k players, best first. Returns how many.
+int rating_store_top(struct rating_store* store, int k, const struct rating_player** out);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "replay.h"
+#include <string.h>
+
+// A replay file is a header followed by games back to back. Each game is:
+//   mode, we_went_first, won        1 byte each
+//   ships 1..5                      row, col, dir, size: 1 byte each
+//   move count                      2 bytes, big endian
+//   moves                           ours, row, col, result, ship: 1 byte each
+#define REPLAY_MAGIC "BSRP"
+#define REPLAY_VERSION 1
+
+#define REPLAY_GAME_HEADER_LENGTH (3 + 4 * (SHIP_COUNT - 1) + 2)
+#define REPLAY_MOVE_LENGTH 5
+
+void replay_add_move(struct replay* replay, int ours, int r, int c, struct pkt_move_result* result) {
+    if (replay->move_count >= REPLAY_MAX_MOVES)
+        return;
+
+    replay->moves[replay->move_count++] = (struct replay_move){
+        .ours = (u8)ours,
+        .row = (u8)r,
+        .col = (u8)c,
+        .result = result->result,
+        .ship = result->result == NET_SINK ? result->ship_type : SHIP_NONE
+    };
+}
+
+int replay_append(const char* path, struct replay* replay) {
+    FILE* file = fopen(path, "ab");
+    if (!file) {
+        perror("replay file error");
+        return -1;
+    }
+
+    // A fresh file needs a header first.
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        fwrite(REPLAY_MAGIC, 1, 4, file);
+        fputc(REPLAY_VERSION, file);
+    }
+
+    u8 buf[REPLAY_GAME_HEADER_LENGTH + REPLAY_MAX_MOVES * REPLAY_MOVE_LENGTH];
+    u8* ptr = buf;
+
+    *ptr++ = (u8)replay->mode;
+    *ptr++ = replay->we_went_first;
+    *ptr++ = replay->won;
+
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        *ptr++ = (u8)replay->ships[ship].row;
+        *ptr++ = (u8)replay->ships[ship].col;
+        *ptr++ = (u8)replay->ships[ship].dir;
+        *ptr++ = (u8)replay->ships[ship].size;
+    }
+
+    *ptr++ = (u8)(replay->move_count >> 8);
+    *ptr++ = (u8)(replay->move_count & 0xFF);
+
+    for (int i = 0; i < replay->move_count; i++) {
+        struct replay_move* move = &replay->moves[i];
+        *ptr++ = move->ours;
+        *ptr++ = move->row;
+        *ptr++ = move->col;
+        *ptr++ = (u8)move->result;
+        *ptr++ = (u8)move->ship;
+    }
+
+    size_t length = ptr - buf;
+    int status = fwrite(buf, 1, length, file) == length ? 0 : -1;
+    if (fclose(file))
+        status = -1;
+
+    if (status)
+        perror("replay write error");
+    return status;
+}
+
+int replay_read_header(FILE* file) {
+    char magic[4];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0)
+        return -1;
+
+    if (fgetc(file) != REPLAY_VERSION)
+        return -1;
+
+    return 0;
+}
+
+int replay_read(FILE* file, struct replay* replay) {
+    u8 header[REPLAY_GAME_HEADER_LENGTH];
+
+    size_t got = fread(header, 1, sizeof header, file);
+    if (got == 0)
+        return 1;
+    if (got != sizeof header)
+        return -1;
+
+    u8* ptr = header;
+    replay->mode = (enum game_mode)*ptr++;
+    replay->we_went_first = *ptr++;
+    replay->won = *ptr++;
+
+    // These end up as array indices in analyze, so anything out of range is a corrupt file.
+    if ((replay->mode != MODE_CLASSIC && replay->mode != MODE_SALVO) || replay->we_went_first > 1 || replay->won > 1)
+        return -1;
+
+    memset(replay->ships, 0, sizeof replay->ships);
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        struct placed_ship* placed = &replay->ships[ship];
+        placed->row = *ptr++;
+        placed->col = *ptr++;
+        placed->dir = *ptr++;
+        placed->size = *ptr++;
+
+        if (placed->row >= BOARD_SIZE || placed->col >= BOARD_SIZE || placed->dir > 1
+            || placed->size > BOARD_SIZE
+            || (placed->dir ? placed->row : placed->col) + placed->size > BOARD_SIZE)
+            return -1;
+    }
+
+    replay->move_count = (ptr[0] << 8) | ptr[1];
+    if (replay->move_count > REPLAY_MAX_MOVES)
+        return -1;
+
+    for (int i = 0; i < replay->move_count; i++) {
+        u8 move[REPLAY_MOVE_LENGTH];
+        if (fread(move, 1, sizeof move, file) != sizeof move)
+            return -1;
+
+        if (move[1] >= BOARD_SIZE || move[2] >= BOARD_SIZE || move[3] > NET_SINK || move[4] >= SHIP_COUNT)
+            return -1;
+
+        replay->moves[i] = (struct replay_move){
+            .ours = move[0] ? 1 : 0,
+            .row = move[1],
+            .col = move[2],
+            .result = (enum net_move_result)move[3],
+            .ship = (enum ship)move[4]
+        };
+    }
+
+    return 0;
+}
\ No newline at end of file
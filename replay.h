@@ -0,0 +1,41 @@
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include "board.h"
+#include "packet.h"
+#include <stdio.h>
+
+// Every square gets shot at most once by each side.
+#define REPLAY_MAX_MOVES (2 * BOARD_SIZE * BOARD_SIZE)
+
+struct replay_move {
+    // 1 if we fired this shot, 0 if they did.
+    u8 ours;
+    u8 row, col;
+    enum net_move_result result;
+    // The ship that was sunk, if any.
+    enum ship ship;
+};
+
+// A game as seen by one of the players.
+struct replay {
+    enum game_mode mode;
+    u8 we_went_first;
+    u8 won;
+    // Our fleet, indexed by ship. Theirs is only known through the ships we sank.
+    struct placed_ship ships[SHIP_COUNT];
+    int move_count;
+    struct replay_move moves[REPLAY_MAX_MOVES];
+};
+
+void replay_add_move(struct replay* replay, int ours, int r, int c, struct pkt_move_result* result);
+
+// Appends a game to a replay file, creating it if needed. Returns -1 on failure.
+int replay_append(const char* path, struct replay* replay);
+
+// Checks the header of a replay file opened for reading. Returns -1 if it isn't one.
+int replay_read_header(FILE* file);
+// Reads the next game. Returns 1 at the end of the file, -1 if the file is corrupt.
+int replay_read(FILE* file, struct replay* replay);
+
+#endif
\ No newline at end of file
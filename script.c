@@ -0,0 +1,113 @@
+#include "script.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+int script_open(struct script* script, const char* path, const struct strategy* bot, u64 seed) {
+    memset(script, 0, sizeof *script);
+    script->path = path;
+    script->bot = bot;
+    rng_seed(&script->rng, seed);
+
+    if (!path)
+        return 0;
+
+    script->file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!script->file) {
+        perror("script error");
+        return -1;
+    }
+    return 0;
+}
+
+void script_close(struct script* script) {
+    if (script->file && script->file != stdin)
+        fclose(script->file);
+    script->file = NULL;
+    free(script->buf);
+    script->buf = NULL;
+}
+
+// Returns the next line that isn't blank or a comment, without its newline, or NULL once the
+// script runs out.
+static char* next_line(struct script* script) {
+    while (script->file) {
+        if (getline(&script->buf, &script->size, script->file) < 0) {
+            if (script->file != stdin)
+                fclose(script->file);
+            script->file = NULL;
+            return NULL;
+        }
+
+        script->line++;
+        script->buf[strcspn(script->buf, "\r\n")] = '\0';
+
+        char* line = script->buf;
+        while (isspace((unsigned char)*line))
+            line++;
+        if (*line != '\0' && *line != '#')
+            return line;
+    }
+    return NULL;
+}
+
+static int invalid(struct script* script, const char* what) {
+    fprintf(stderr, "%s:%i: invalid %s\n", strcmp(script->path, "-") == 0 ? "stdin" : script->path, script->line, what);
+    return -1;
+}
+
+static int parse_coord(const char* text, int* r, int* c, int* used) {
+    char col;
+    int row;
+
+    if (sscanf(text, "%c%i%n", &col, &row, used) != 2)
+        return -1;
+    col = (char)toupper((unsigned char)col);
+    if (row < 1 || row > BOARD_SIZE || col < 'A' || col >= 'A' + BOARD_SIZE)
+        return -1;
+
+    *r = row - 1;
+    *c = col - 'A';
+    return 0;
+}
+
+int script_place(struct script* script, struct our_board* board) {
+    ourboard_init(board);
+
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        char* line = next_line(script);
+
+        // Half a fleet can't be finished sensibly, so the bot only takes over from an empty board.
+        if (!line || (ship == AIRCRAFT_CARRIER && strcmp(line, "bot") == 0)) {
+            if (ship != AIRCRAFT_CARRIER)
+                return invalid(script, "fleet, it ends early");
+            script->bot->place(board, &script->rng);
+            return 0;
+        }
+
+        int r, c, used;
+        char dir;
+        if (parse_coord(line, &r, &c, &used) || sscanf(line + used, " %c", &dir) != 1)
+            return invalid(script, "placement");
+
+        dir = (char)toupper((unsigned char)dir);
+        if ((dir != 'H' && dir != 'V') || ship_obstructed(board, r, c, dir == 'V', ship_size(ship)))
+            return invalid(script, "placement");
+
+        place_ship(board, ship, r, c, dir == 'V', ship_size(ship));
+    }
+
+    return 0;
+}
+
+int script_shoot(struct script* script, struct their_board* board, int* r, int* c) {
+    char* line = next_line(script);
+
+    if (!line || strcmp(line, "bot") == 0)
+        return script->bot->shoot(board, &script->rng, r, c);
+
+    int used;
+    if (parse_coord(line, r, c, &used) || board->hits[*r][*c] != HS_NONE)
+        return invalid(script, "shot");
+    return 0;
+}
\ No newline at end of file
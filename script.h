@@ -0,0 +1,38 @@
+#ifndef _SCRIPT_H
+#define _SCRIPT_H
+
+#include <stdio.h>
+#include "strategy.h"
+
+// Plays without a human. Placements and shots are read from a script, one per line:
+//
+//   A1 H         where to put the next ship (carrier first, destroyer last) and which way it faces
+//   bot          at the start: let the bot place the whole fleet
+//   B3           a square to shoot at
+//   bot          let the bot pick the shot
+//
+// Blank lines and lines starting with # are skipped. Once the script runs out (or if there is
+// none) the bot makes every move.
+struct script {
+    // NULL once the script has run out.
+    FILE* file;
+    const char* path;
+    int line;
+    char* buf;
+    size_t size;
+
+    const struct strategy* bot;
+    struct rng rng;
+};
+
+// Opens the script at path, "-" for stdin or NULL to leave everything to the bot. Returns -1
+// on failure.
+int script_open(struct script* script, const char* path, const struct strategy* bot, u64 seed);
+void script_close(struct script* script);
+
+// Places every ship on a cleared board. Returns -1 if the script is invalid.
+int script_place(struct script* script, struct our_board* board);
+// Picks an unshot square. Returns -1 if the script is invalid or the bot has nothing to shoot.
+int script_shoot(struct script* script, struct their_board* board, int* r, int* c);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "sim.h"
+#include "batch.h"
+#include <stdlib.h>
+
+int sim_play(struct our_board* fleet, const struct strategy* strategy, struct rng* rng, sim_observer observe, void* ctx) {
+    struct their_board view;
+    their_board_init(&view);
+
+    int remaining[SHIP_COUNT];
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++)
+        remaining[ship] = fleet->placements[ship].size;
+
+    int ships_left = fleet->ship_count;
+    int shots = 0;
+
+    while (ships_left > 0) {
+        int r, c;
+        if (strategy->shoot(&view, rng, &r, &c))
+            return -1;
+        if (r < 0 || c < 0 || r >= BOARD_SIZE || c >= BOARD_SIZE || view.hits[r][c] != HS_NONE)
+            return -1;
+
+        shots++;
+
+        enum ship ship = fleet->ships[r][c];
+        enum ship sunk = ship != SHIP_NONE && remaining[ship] == 1 ? ship : SHIP_NONE;
+        if (observe)
+            observe(ctx, &view, r, c, ship == SHIP_NONE ? MISS : HIT, sunk);
+
+        if (ship == SHIP_NONE) {
+            view.hits[r][c] = MISS;
+            continue;
+        }
+
+        view.hits[r][c] = HIT;
+        if (--remaining[ship] == 0) {
+            view.sunk[ship] = fleet->placements[ship];
+            ships_left--;
+        }
+    }
+
+    return shots;
+}
+
+u64 sim_game_seed(u64 seed, int game, int stream) {
+    return seed + (u64)game * 2654435761u + (u64)stream * 0x9E3779B97F4A7C15ull;
+}
+
+int sim_shots_to_win(struct our_board* fleet, const struct strategy* strategy, struct rng* rng) {
+    return sim_play(fleet, strategy, rng, NULL, NULL);
+}
+
+int sim_play_batch(struct our_board* fleets, int count, const struct strategy* strategy, struct rng* rngs, u16* shots) {
+    struct batch batch;
+    if (batch_init(&batch, count))
+        return -1;
+
+    struct their_board* views = malloc(count * sizeof(struct their_board));
+    i32* squares = malloc(batch.count * sizeof(i32));
+    u8* results = malloc(batch.count);
+    u8* sunk = malloc(batch.count);
+    int status = views && squares && results && sunk ? 0 : -1;
+
+    for (int g = 0; g < batch.count && status == 0; g++) {
+        squares[g] = -1;
+        if (g >= count)
+            continue;
+
+        their_board_init(&views[g]);
+        batch_set_fleet(&batch, g, &fleets[g]);
+        shots[g] = 0;
+    }
+
+    int playing = count;
+    while (playing > 0 && status == 0) {
+        for (int g = 0; g < count; g++) {
+            if (batch.ships_left[g] == 0) {
+                squares[g] = -1;
+                continue;
+            }
+
+            int r, c;
+            if (strategy->shoot(&views[g], &rngs[g], &r, &c)
+                || r < 0 || c < 0 || r >= BOARD_SIZE || c >= BOARD_SIZE || views[g].hits[r][c] != HS_NONE) {
+                status = -1;
+                break;
+            }
+
+            squares[g] = r * BOARD_SIZE + c;
+            shots[g]++;
+        }
+        if (status)
+            break;
+
+        playing -= batch_fire(&batch, squares, results, sunk);
+
+        for (int g = 0; g < count; g++) {
+            if (results[g] == HS_NONE)
+                continue;
+
+            views[g].hits[squares[g] / BOARD_SIZE][squares[g] % BOARD_SIZE] = results[g];
+            if (sunk[g] != SHIP_NONE)
+                views[g].sunk[sunk[g]] = fleets[g].placements[sunk[g]];
+        }
+    }
+
+    free(sunk);
+    free(results);
+    free(squares);
+    free(views);
+    batch_free(&batch);
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+#include "strategy.h"
+
+// Called for every shot with the board as the shooter saw it when choosing, where it shot, what
+// that shot did and which ship it sank (SHIP_NONE if none).
+typedef void (*sim_observer)(void* ctx, const struct their_board* view, int r, int c, enum hit_state result, enum ship sunk);
+
+// Fires a strategy at a fleet until every ship is sunk and returns how many shots that took, or
+// -1 if the strategy gave up or picked a square it had already shot. The fleet itself isn't
+// changed. observe can be NULL.
+int sim_play(struct our_board* fleet, const struct strategy* strategy, struct rng* rng, sim_observer observe, void* ctx);
+
+// Plays count games in lockstep, fleets[g] with its own rng[g], resolving each round of shots
+// with the batch engine. shots[g] gets what sim_shots_to_win would have returned for the same
+// fleet and rng. Returns -1 if the strategy misbehaves or memory runs out.
+int sim_play_batch(struct our_board* fleets, int count, const struct strategy* strategy, struct rng* rngs, u16* shots);
+
+// Seeds the rng for one stream of game `game` in a run seeded with `seed`. Anything that plays
+// several strategies on the same games places with stream 0 and shoots with stream 1, so the
+// strategies only differ in how they play and not in the dice.
+u64 sim_game_seed(u64 seed, int game, int stream);
+
+// sim_play without an observer.
+int sim_shots_to_win(struct our_board* fleet, const struct strategy* strategy, struct rng* rng);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "strategy.h"
+#include "ai.h"
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+static int in_bounds(int r, int c) {
+    return r >= 0 && c >= 0 && r < BOARD_SIZE && c < BOARD_SIZE;
+}
+
+static int is_sunk(struct their_board* board, int r, int c) {
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        struct placed_ship* sunk = &board->sunk[ship];
+        if (sunk->size == 0)
+            continue;
+
+        if (sunk->dir ? (c == sunk->col && r >= sunk->row && r < sunk->row + sunk->size)
+                      : (r == sunk->row && c >= sunk->col && c < sunk->col + sunk->size))
+            return 1;
+    }
+    return 0;
+}
+
+// Picks uniformly among the unshot squares accepted by `filter`. Returns -1 if there are none.
+static int shoot_random_where(struct their_board* board, struct rng* rng, int (*filter)(struct their_board*, int, int), int* r, int* c) {
+    int candidates[BOARD_SIZE * BOARD_SIZE];
+    int count = 0;
+
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            if (board->hits[i][j] == HS_NONE && (!filter || filter(board, i, j)))
+                candidates[count++] = i * BOARD_SIZE + j;
+        }
+    }
+
+    if (count == 0)
+        return -1;
+
+    int pick = candidates[rng_range(rng, count)];
+    *r = pick / BOARD_SIZE;
+    *c = pick % BOARD_SIZE;
+    return 0;
+}
+
+// An unshot square next to a hit that isn't part of a sunk ship.
+static int next_to_open_hit(struct their_board* board, int r, int c) {
+    static const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+    for (int i = 0; i < 4; i++) {
+        int nr = r + offsets[i][0], nc = c + offsets[i][1];
+        if (in_bounds(nr, nc) && board->hits[nr][nc] == HIT && !is_sunk(board, nr, nc))
+            return 1;
+    }
+    return 0;
+}
+
+// The smallest ship is 2 long, so every ship covers at least one square of a checkerboard.
+static int on_parity(struct their_board* board, int r, int c) {
+    (void)board;
+    return (r + c) % 2 == 0;
+}
+
+static void place_random(struct our_board* board, struct rng* rng) {
+    board_init_random(board, rng);
+}
+
+static int shoot_random(struct their_board* board, struct rng* rng, int* r, int* c) {
+    return shoot_random_where(board, rng, NULL, r, c);
+}
+
+// Random shots until something is hit, then the squares around it until it sinks.
+static int shoot_hunt(struct their_board* board, struct rng* rng, int* r, int* c) {
+    if (shoot_random_where(board, rng, next_to_open_hit, r, c) == 0)
+        return 0;
+    return shoot_random(board, rng, r, c);
+}
+
+// Like hunt, but only searches a checkerboard.
+static int shoot_parity(struct their_board* board, struct rng* rng, int* r, int* c) {
+    if (shoot_random_where(board, rng, next_to_open_hit, r, c) == 0)
+        return 0;
+    if (shoot_random_where(board, rng, on_parity, r, c) == 0)
+        return 0;
+    return shoot_random(board, rng, r, c);
+}
+
+static int shoot_ai(struct their_board* board, struct rng* rng, int* r, int* c) {
+    return ai_choose_shot(board, NULL, rng, r, c);
+}
+
+static const struct strategy builtin_strategies[] = {
+    { .name = "random", .place = place_random, .shoot = shoot_random },
+    { .name = "hunt", .place = place_random, .shoot = shoot_hunt },
+    { .name = "parity", .place = place_random, .shoot = shoot_parity },
+    { .name = "ai", .place = place_random, .shoot = shoot_ai },
+};
+
+static const struct strategy* registry[STRATEGY_MAX];
+static int registry_count = -1;
+
+static void register_builtins() {
+    if (registry_count >= 0)
+        return;
+
+    registry_count = 0;
+    for (size_t i = 0; i < sizeof builtin_strategies / sizeof builtin_strategies[0]; i++)
+        registry[registry_count++] = &builtin_strategies[i];
+}
+
+int strategy_register(const struct strategy* strategy) {
+    register_builtins();
+
+    if (!strategy->name || !strategy->place || !strategy->shoot) {
+        fprintf(stderr, "strategy is missing a name, place or shoot function\n");
+        return -1;
+    }
+
+    if (strategy_find(strategy->name)) {
+        fprintf(stderr, "there's already a strategy called %s\n", strategy->name);
+        return -1;
+    }
+
+    if (registry_count >= STRATEGY_MAX) {
+        fprintf(stderr, "too many strategies\n");
+        return -1;
+    }
+
+    registry[registry_count++] = strategy;
+    return 0;
+}
+
+int strategy_load_plugin(const char* path) {
+    // Plugins stay loaded until exit, their strategies point into them.
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "plugin error: %s\n", dlerror());
+        return -1;
+    }
+
+    strategy_plugin_fn plugin = (strategy_plugin_fn)dlsym(handle, STRATEGY_PLUGIN_SYMBOL);
+    if (!plugin) {
+        fprintf(stderr, "plugin error: %s doesn't export %s\n", path, STRATEGY_PLUGIN_SYMBOL);
+        dlclose(handle);
+        return -1;
+    }
+
+    const struct strategy* const* strategies = plugin();
+    for (; strategies && *strategies; strategies++) {
+        if (strategy_register(*strategies))
+            return -1;
+    }
+
+    return 0;
+}
+
+int strategy_count() {
+    register_builtins();
+    return registry_count;
+}
+
+const struct strategy* strategy_get(int idx) {
+    register_builtins();
+    return idx >= 0 && idx < registry_count ? registry[idx] : NULL;
+}
+
+const struct strategy* strategy_find(const char* name) {
+    register_builtins();
+    for (int i = 0; i < registry_count; i++) {
+        if (strcmp(registry[i]->name, name) == 0)
+            return registry[i];
+    }
+    return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef _STRATEGY_H
+#define _STRATEGY_H
+
+#include "board.h"
+
+// A way of playing: where to put the fleet and where to shoot. Both get their own random stream,
+// so a strategy must be deterministic given its rng.
+struct strategy {
+    const char* name;
+    // Places every ship on a cleared board.
+    void (*place)(struct our_board* board, struct rng* rng);
+    // Picks an unshot square. Returns -1 if there's nothing left to shoot.
+    int (*shoot)(struct their_board* board, struct rng* rng, int* r, int* c);
+};
+
+// Plugins are shared objects exporting this function, which returns a NULL terminated array of
+// strategies that stay valid for as long as the plugin is loaded. Plugins can call into the game
+// (board.h, ai.h, ...) since the executable exports its symbols.
+#define STRATEGY_PLUGIN_SYMBOL "battleship_strategies"
+typedef const struct strategy* const* (*strategy_plugin_fn)(void);
+
+#define STRATEGY_MAX 256
+
+// Returns -1 if the name is taken or the registry is full.
+int strategy_register(const struct strategy* strategy);
+// Loads a plugin and registers its strategies. Returns -1 on failure.
+int strategy_load_plugin(const char* path);
+
+int strategy_count();
+const struct strategy* strategy_get(int idx);
+// Returns NULL if there's no strategy by that name.
+const struct strategy* strategy_find(const char* name);
+
+#endif
\ No newline at end of file
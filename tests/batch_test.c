@@ -0,0 +1,107 @@
+// Differential check of batch_fire against batch_fire_scalar: the same volleys into two copies of
+// the same games, which have to agree on every result and every byte of state afterwards.
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHIPS (SHIP_COUNT - 1)
+
+// Not a multiple of BATCH_LANES, so the padding games get fired into too.
+#define GAMES 1001
+
+static int same(const char* what, const u32* a, const u32* b, size_t count, long volley) {
+    for (size_t i = 0; i < count; i++) {
+        if (a[i] != b[i]) {
+            fprintf(stderr, "volley %ld: %s[%zu] is %u, scalar has %u\n", volley, what, i, a[i], b[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    long volleys = argc > 1 ? atol(argv[1]) : 20000;
+    u64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (!__builtin_cpu_supports("avx2"))
+        printf("no AVX2 here, batch_fire is the scalar path and this only checks it against itself\n");
+#endif
+
+    struct rng rng;
+    rng_seed(&rng, seed);
+
+    struct batch vector, scalar;
+    if (batch_init(&vector, GAMES) || batch_init(&scalar, GAMES)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    int count = vector.count;
+
+    for (int g = 0; g < GAMES; g++) {
+        struct our_board fleet;
+        board_init_random(&fleet, &rng);
+        batch_set_fleet(&vector, g, &fleet);
+        batch_set_fleet(&scalar, g, &fleet);
+    }
+
+    i32* squares = malloc(count * sizeof(i32));
+    u8* results[2] = { malloc(count), malloc(count) };
+    u8* sunk[2] = { malloc(count), malloc(count) };
+    if (!squares || !results[0] || !results[1] || !sunk[0] || !sunk[1]) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    long wins = 0;
+    for (long volley = 0; volley < volleys; volley++) {
+        // Some games sit the volley out, and after the first hundred or so most squares picked
+        // have already been shot.
+        for (int g = 0; g < count; g++)
+            squares[g] = rng_range(&rng, 8) == 0 ? -1 : (i32)rng_range(&rng, BOARD_SIZE * BOARD_SIZE);
+
+        int won = batch_fire(&vector, squares, results[0], sunk[0]);
+        int expected = batch_fire_scalar(&scalar, squares, results[1], sunk[1]);
+
+        if (won != expected) {
+            fprintf(stderr, "volley %ld: batch_fire won %i games, scalar %i\n", volley, won, expected);
+            return 1;
+        }
+        for (int g = 0; g < count; g++) {
+            if (results[0][g] != results[1][g] || sunk[0][g] != sunk[1][g]) {
+                fprintf(stderr, "volley %ld, game %i, square %i: result %u sunk %u, scalar has %u and %u\n",
+                    volley, g, squares[g], results[0][g], sunk[0][g], results[1][g], sunk[1][g]);
+                return 1;
+            }
+        }
+
+        if (!same("ships", vector.ships, scalar.ships, (size_t)SHIPS * BATCH_WORDS * count, volley)
+            || !same("remaining", vector.remaining, scalar.remaining, (size_t)SHIPS * count, volley)
+            || !same("shot", vector.shot, scalar.shot, (size_t)BATCH_WORDS * count, volley)
+            || !same("ships_left", vector.ships_left, scalar.ships_left, (size_t)count, volley))
+            return 1;
+
+        // Finished games start over with a new fleet, so every volley still has live games in it.
+        wins += won;
+        for (int g = 0; g < GAMES; g++) {
+            if (scalar.ships_left[g] == 0) {
+                struct our_board fleet;
+                board_init_random(&fleet, &rng);
+                batch_set_fleet(&vector, g, &fleet);
+                batch_set_fleet(&scalar, g, &fleet);
+            }
+        }
+    }
+
+    printf("%ld volleys into %i games agree, %ld games won\n", volleys, GAMES, wins);
+
+    free(squares);
+    for (int i = 0; i < 2; i++) {
+        free(results[i]);
+        free(sunk[i]);
+    }
+    batch_free(&vector);
+    batch_free(&scalar);
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Differential check of the bitboard fleet_validate against the per-square ship_obstructed it
+// replaced, on random fleets that are mostly nearly legal, since those are the ones that matter.
+#include "board.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// The original rules: every ship on the board and facing a real direction, and none of its
+// squares on or next to a ship placed before it.
+static int reference_validate(const struct fleet* fleet) {
+    struct our_board board;
+    ourboard_init(&board);
+
+    for (int ship = AIRCRAFT_CARRIER; ship < SHIP_COUNT; ship++) {
+        const struct packed_ship* packed = &fleet->ships[ship - 1];
+        int size = ship_size(ship);
+        if (packed->row >= BOARD_SIZE || packed->col >= BOARD_SIZE || packed->dir > 1
+            || ship_obstructed(&board, packed->row, packed->col, packed->dir, size))
+            return -1;
+        place_ship(&board, ship, packed->row, packed->col, packed->dir, size);
+    }
+
+    return 0;
+}
+
+static void random_fleet(struct rng* rng, struct fleet* fleet) {
+    switch (rng_range(rng, 3)) {
+    case 0:
+        // Any bytes at all.
+        for (int i = 0; i < SHIP_COUNT - 1; i++) {
+            fleet->ships[i].row = (u8)rng_next(rng);
+            fleet->ships[i].col = (u8)rng_next(rng);
+            fleet->ships[i].dir = (u8)rng_next(rng);
+        }
+        break;
+    case 1:
+        // Around the edges of the board, where off-by-ones live.
+        for (int i = 0; i < SHIP_COUNT - 1; i++) {
+            fleet->ships[i].row = (u8)rng_range(rng, BOARD_SIZE + 2);
+            fleet->ships[i].col = (u8)rng_range(rng, BOARD_SIZE + 2);
+            fleet->ships[i].dir = (u8)rng_range(rng, 3);
+        }
+        break;
+    default: {
+        // A legal fleet with one ship nudged.
+        struct our_board board;
+        board_init_random(&board, rng);
+        fleet_pack(&board, fleet);
+
+        struct packed_ship* ship = &fleet->ships[rng_range(rng, SHIP_COUNT - 1)];
+        u8* field = rng_range(rng, 3) == 0 ? &ship->row : rng_range(rng, 2) ? &ship->col : &ship->dir;
+        *field += (u8)(rng_range(rng, 5) - 2);
+    } break;
+    }
+}
+
+#define BATCH 256
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    u64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+
+    struct rng rng;
+    rng_seed(&rng, seed);
+
+    struct fleet fleets[BATCH];
+    i8 results[BATCH];
+    long legal = 0;
+
+    for (long done = 0; done < iterations; done += BATCH) {
+        for (int i = 0; i < BATCH; i++)
+            random_fleet(&rng, &fleets[i]);
+
+        int batch_legal = fleet_validate_batch(fleets, BATCH, results);
+        int expected_legal = 0;
+
+        for (int i = 0; i < BATCH; i++) {
+            int expected = reference_validate(&fleets[i]);
+            expected_legal += expected == 0;
+
+            if (fleet_validate(&fleets[i]) != expected || results[i] != expected) {
+                fprintf(stderr, "fleet %ld disagrees: reference %i, fleet_validate %i, batch %i\n",
+                    done + i, expected, fleet_validate(&fleets[i]), results[i]);
+                for (int s = 0; s < SHIP_COUNT - 1; s++)
+                    fprintf(stderr, "  ship %i: row %u col %u dir %u\n", s + 1,
+                        fleets[i].ships[s].row, fleets[i].ships[s].col, fleets[i].ships[s].dir);
+                return 1;
+            }
+        }
+
+        if (batch_legal != expected_legal) {
+            fprintf(stderr, "batch counted %i legal fleets, expected %i\n", batch_legal, expected_legal);
+            return 1;
+        }
+        legal += expected_legal;
+    }
+
+    printf("%ld fleets agree, %ld legal\n", (iterations + BATCH - 1) / BATCH * BATCH, legal);
+    return 0;
+}
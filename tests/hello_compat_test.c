@@ -0,0 +1,196 @@
+// Plays clients from before version negotiation against a current server, which has to answer
+// each in the hello format it sent. A client from before game modes only understands a bare
+// magic back, and a version 1 client one with at most the mode after it.
+#include "board.h"
+#include "network.h"
+#include "packet.h"
+#include "transport.h"
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Starts a server and returns its pid, with the port it says it's listening on in `port`. Without
+// a port to listen on, the server picks a free one.
+static pid_t start_server(const char* battleship, const char* listen_port, const char* mode, int* port) {
+    int out[2];
+    if (pipe(out) < 0) {
+        perror("pipe error");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(out[1]);
+        if (listen_port)
+            execl(battleship, battleship, "server", listen_port, "--bot", "random", "--seed", "1", mode, (char*)NULL);
+        else
+            execl(battleship, battleship, "server", "--bot", "random", "--seed", "1", mode, (char*)NULL);
+        perror("exec error");
+        _exit(127);
+    }
+    close(out[1]);
+
+    FILE* file = fdopen(out[0], "r");
+    char line[256];
+    *port = 0;
+    while (*port == 0 && fgets(line, sizeof line, file))
+        sscanf(line, "Server listening on port %i", port);
+
+    if (*port == 0) {
+        fprintf(stderr, "server didn't say which port it's on\n");
+        exit(1);
+    }
+
+    // The rest of a game's output fits in the pipe, so it's left open and unread.
+    return pid;
+}
+
+static int connect_to(int port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((u16)port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof addr) < 0) {
+        perror("connect error");
+        exit(1);
+    }
+    return fd;
+}
+
+static void read_exactly(int fd, u8* buf, size_t length) {
+    for (size_t got = 0; got < length;) {
+        ssize_t n = recv(fd, buf + got, length - got, 0);
+        if (n <= 0) {
+            fprintf(stderr, "server hung up during the hello\n");
+            exit(1);
+        }
+        got += (size_t)n;
+    }
+}
+
+// Sends a hello by hand, since our own client only speaks the current format, and checks the
+// reply is the same length as what we sent.
+static void old_hello(int fd, const u8* body, u16 length, u8 expected_mode) {
+    u8 buf[8] = { PKT_CLIENT_HELLO, 0, (u8)length };
+    memcpy(buf + 3, body, length);
+    if (send(fd, buf, 3 + length, 0) != 3 + length) {
+        perror("send error");
+        exit(1);
+    }
+
+    u8 reply[8];
+    read_exactly(fd, reply, 3);
+    u16 reply_length = (u16)(reply[1] << 8 | reply[2]);
+    if (reply[0] != PKT_SERVER_HELLO || reply_length != length) {
+        fprintf(stderr, "sent a %u byte hello, got packet %u with %u bytes back\n", length, reply[0], reply_length);
+        exit(1);
+    }
+
+    read_exactly(fd, reply, length);
+    if (memcmp(reply, body, 4) != 0 || (length == 5 && reply[4] != expected_mode)) {
+        fprintf(stderr, "bad server hello\n");
+        exit(1);
+    }
+}
+
+static void expect(struct connection* conn, struct packet* pkt, enum packet_type type) {
+    if (recv_packet(conn, pkt) || pkt->type != type) {
+        fprintf(stderr, "expected packet %i\n", type);
+        exit(1);
+    }
+}
+
+// Plays a classic game in the version 1 encoding, shooting every square in order.
+static void play_classic(struct connection* conn) {
+    struct our_board board;
+    struct rng rng;
+    rng_seed(&rng, 2);
+    board_init_random(&board, &rng);
+
+    struct packet incoming, outgoing = { .type = PKT_SHIPS_READY };
+    expect(conn, &incoming, PKT_SERVER_READY);
+    send_packet(conn, &outgoing);
+    expect(conn, &incoming, PKT_SHIPS_READY);
+    expect(conn, &incoming, PKT_BEGIN_GAME);
+
+    enum peer_type turn = incoming.begin_game.first;
+    int next_square = 0;
+    while (1) {
+        if (turn == PEER_CLIENT) {
+            outgoing.type = PKT_MOVE;
+            outgoing.move = (struct pkt_move){ .row = next_square / BOARD_SIZE, .col = next_square % BOARD_SIZE };
+            next_square++;
+            send_packet(conn, &outgoing);
+            expect(conn, &incoming, PKT_MOVE_RESULT);
+            if (incoming.move_result.win)
+                return;
+        } else {
+            expect(conn, &incoming, PKT_MOVE);
+            int r = incoming.move.row, c = incoming.move.col;
+            enum ship ship = board.ships[r][c];
+
+            outgoing.type = PKT_MOVE_RESULT;
+            outgoing.move_result = (struct pkt_move_result){ .result = NET_MISS };
+            if (ship != SHIP_NONE && --board.placements[ship].count == 0) {
+                struct placed_ship* sunk = &board.placements[ship];
+                outgoing.move_result = (struct pkt_move_result){
+                    .result = NET_SINK, .ship_type = ship, .ship_row = sunk->row, .ship_col = sunk->col,
+                    .ship_dir = sunk->dir, .ship_size = sunk->size, .win = --board.ship_count == 0
+                };
+            } else if (ship != SHIP_NONE) {
+                outgoing.move_result.result = NET_HIT;
+            }
+            send_packet(conn, &outgoing);
+            if (outgoing.move_result.win)
+                return;
+        }
+        turn = turn == PEER_CLIENT ? PEER_SERVER : PEER_CLIENT;
+    }
+}
+
+static void expect_exit(pid_t pid, int code) {
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != code) {
+        fprintf(stderr, "server didn't exit with %i\n", code);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <battleship>\n", argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    const u8 magic[5] = { 0x00, 0xBA, 0x11, 0x7E, MODE_SALVO };
+    int port;
+
+    // A client from before game modes asks for nothing, so even a salvo server plays classic with
+    // it and answers with the bare magic. This server is given no port, like `battleship server`.
+    pid_t pid = start_server(argv[1], NULL, "--salvo", &port);
+    struct connection conn;
+    int fd = connect_to(port);
+    old_hello(fd, magic, 4, 0);
+    tcp_connection_init(&conn, PEER_CLIENT, fd);
+    play_classic(&conn);
+    connection_close(&conn);
+    expect_exit(pid, 0);
+
+    // A version 1 client asking for salvo gets the mode back and nothing after it.
+    pid = start_server(argv[1], "0", "--salvo", &port);
+    fd = connect_to(port);
+    old_hello(fd, magic, 5, MODE_SALVO);
+    close(fd);
+    waitpid(pid, NULL, 0);
+
+    printf("old hellos answered in kind\n");
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Several producers push numbered elements into one queue while the consumer drains it, sleeping
+// whenever it runs dry. Every element has to come out exactly once and in order per producer.
+#include "mpsc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#define PRODUCERS 4
+#define PER_PRODUCER 250000
+#define CAPACITY 256
+#define BATCH 32
+
+struct element {
+    u32 producer;
+    u32 sequence;
+};
+
+static struct mpsc_queue queue;
+
+static void* producer(void* arg) {
+    u32 id = (u32)(size_t)arg;
+    for (u32 i = 0; i < PER_PRODUCER; i++) {
+        struct element element = { .producer = id, .sequence = i };
+        while (mpsc_push(&queue, &element))
+            sched_yield();
+    }
+    return NULL;
+}
+
+int main(void) {
+    if (mpsc_init(&queue, CAPACITY, sizeof(struct element))) {
+        fprintf(stderr, "mpsc_init failed\n");
+        return 1;
+    }
+
+    pthread_t threads[PRODUCERS];
+    for (size_t i = 0; i < PRODUCERS; i++)
+        pthread_create(&threads[i], NULL, producer, (void*)i);
+
+    u32 next[PRODUCERS] = {0};
+    long total = 0;
+    while (total < (long)PRODUCERS * PER_PRODUCER) {
+        // A lost wakeup would leave us asleep with elements queued, so don't wait forever.
+        if (mpsc_wait(&queue, 5000)) {
+            fprintf(stderr, "timed out after %ld elements\n", total);
+            return 1;
+        }
+
+        struct element batch[BATCH];
+        size_t count = mpsc_pop_batch(&queue, batch, BATCH);
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i].producer >= PRODUCERS || batch[i].sequence != next[batch[i].producer]) {
+                fprintf(stderr, "got %u from producer %u, expected %u\n",
+                    batch[i].sequence, batch[i].producer, next[batch[i].producer % PRODUCERS]);
+                return 1;
+            }
+            next[batch[i].producer]++;
+        }
+        total += count;
+    }
+
+    for (int i = 0; i < PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+
+    struct element extra;
+    if (mpsc_pop_batch(&queue, &extra, 1)) {
+        fprintf(stderr, "queue should be empty\n");
+        return 1;
+    }
+
+    mpsc_destroy(&queue);
+    printf("%ld elements from %i producers\n", total, PRODUCERS);
+    return 0;
+}
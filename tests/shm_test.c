@@ -0,0 +1,81 @@
+// The shared memory transport's name has to be gone once a game is over or can no longer
+// happen: taken down by the client when it joins, or by the server if nobody ever did.
+#include "transport.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int name_exists(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return 0;
+    close(fd);
+    return 1;
+}
+
+static int check(int ok, const char* what) {
+    if (!ok)
+        fprintf(stderr, "%s\n", what);
+    return ok;
+}
+
+int main(void) {
+    char name[64];
+    snprintf(name, sizeof name, "/battleship-test-%i", (int)getpid());
+    struct connection server, client;
+
+    // Nobody joins, and the server closes.
+    if (shm_connection_create(&server, name))
+        return 1;
+    if (!check(name_exists(name), "created region has no name"))
+        return 1;
+    connection_close(&server);
+    if (!check(!name_exists(name), "closing an unjoined server left the region behind"))
+        return 1;
+
+    // Nobody joins, and the server exits without closing, like it does on a timeout.
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (shm_connection_create(&server, name))
+            _exit(2);
+        exit(1);
+    }
+    waitpid(pid, NULL, 0);
+    if (!check(!name_exists(name), "a server exiting before anyone joined left the region behind"))
+        return 1;
+
+    // Another server clears the name out and takes it over before anyone joins ours. Closing
+    // ours mustn't take theirs down.
+    if (shm_connection_create(&server, name))
+        return 1;
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd >= 0)
+        close(fd);
+    connection_close(&server);
+    int survived = name_exists(name);
+    shm_unlink(name);
+    if (!check(survived, "closing took down a region that wasn't ours"))
+        return 1;
+
+    // A client joins and takes the name down, then the two talk.
+    if (shm_connection_create(&server, name) || shm_connection_open(&client, name))
+        return 1;
+    if (!check(!name_exists(name), "joining didn't take the name down"))
+        return 1;
+
+    struct packet outgoing = { .type = PKT_SERVER_READY }, incoming;
+    send_packet(&server, &outgoing);
+    if (!check(recv_packet(&client, &incoming) == 0 && incoming.type == PKT_SERVER_READY, "packet didn't arrive"))
+        return 1;
+
+    connection_close(&server);
+    connection_close(&client);
+
+    printf("shared memory names cleaned up\n");
+    return 0;
+}
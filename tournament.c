@@ -0,0 +1,218 @@
+#include "tournament.h"
+#include "sim.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Rating iterations stop once no strength moves by more than this (relative).
+#define FIT_TOLERANCE 1e-9
+#define FIT_MAX_ITERATIONS 10000
+// Games of a cell played in lockstep at a time.
+#define GAME_CHUNK 256
+
+// Ships don't interact across the two boards, so a game comes down to who needs fewer shots to
+// sink the other's fleet. Instead of playing each pairing, shots[(x * count + y) * games + g] is
+// how many shots strategy x needs against the fleet strategy y places in game g, and every
+// pairing is read off that.
+struct tournament_job {
+    const struct strategy** strategies;
+    int count;
+    struct tournament_options* options;
+    u16* shots;
+    // Next (shooter, placer) cell to hand out.
+    _Atomic int next;
+    _Atomic int failed;
+};
+
+static void* worker(void* arg) {
+    struct tournament_job* job = arg;
+    int games = job->options->games;
+    int cell;
+
+    struct our_board* fleets = malloc(GAME_CHUNK * sizeof(struct our_board));
+    struct rng* rngs = malloc(GAME_CHUNK * sizeof(struct rng));
+    if (!fleets || !rngs) {
+        atomic_store(&job->failed, 1);
+        goto done;
+    }
+
+    while ((cell = atomic_fetch_add(&job->next, 1)) < job->count * job->count) {
+        const struct strategy* shooter = job->strategies[cell / job->count];
+        const struct strategy* placer = job->strategies[cell % job->count];
+        u16* shots = &job->shots[(size_t)cell * games];
+
+        for (int first = 0; first < games; first += GAME_CHUNK) {
+            int chunk = games - first < GAME_CHUNK ? games - first : GAME_CHUNK;
+
+            for (int i = 0; i < chunk; i++) {
+                rng_seed(&rngs[i], sim_game_seed(job->options->seed, first + i, 0));
+                ourboard_init(&fleets[i]);
+                placer->place(&fleets[i], &rngs[i]);
+                if (fleets[i].ship_count != SHIP_COUNT - 1) {
+                    fprintf(stderr, "%s placed %i of %i ships\n", placer->name, fleets[i].ship_count, SHIP_COUNT - 1);
+                    atomic_store(&job->failed, 1);
+                    goto done;
+                }
+
+                rng_seed(&rngs[i], sim_game_seed(job->options->seed, first + i, 1));
+            }
+
+            if (sim_play_batch(fleets, chunk, shooter, rngs, &shots[first])) {
+                fprintf(stderr, "%s made an illegal shot\n", shooter->name);
+                atomic_store(&job->failed, 1);
+                goto done;
+            }
+        }
+    }
+
+done:
+    free(rngs);
+    free(fleets);
+    return NULL;
+}
+
+// Fits Bradley-Terry strengths to the win matrix with the usual minorization-maximization
+// iteration. Every pairing gets one extra drawn game so a strategy that never loses (or never
+// wins) still ends up with a finite rating.
+static void fit_strengths(const double* wins, int count, int games, double* strength) {
+    double* next = calloc(count, sizeof(double));
+
+    for (int i = 0; i < count; i++)
+        strength[i] = 1;
+
+    for (int iter = 0; iter < FIT_MAX_ITERATIONS; iter++) {
+        double change = 0;
+
+        for (int i = 0; i < count; i++) {
+            double won = 0, denom = 0;
+            for (int j = 0; j < count; j++) {
+                if (j == i)
+                    continue;
+                won += wins[i * count + j] + 0.5;
+                denom += (games + 1) / (strength[i] + strength[j]);
+            }
+            next[i] = won / denom;
+        }
+
+        // Strengths are only defined up to scale, so keep their geometric mean at 1.
+        double log_mean = 0;
+        for (int i = 0; i < count; i++)
+            log_mean += log(next[i]);
+        log_mean /= count;
+
+        for (int i = 0; i < count; i++) {
+            next[i] /= exp(log_mean);
+            change = fmax(change, fabs(next[i] - strength[i]) / strength[i]);
+            strength[i] = next[i];
+        }
+
+        if (change < FIT_TOLERANCE)
+            break;
+    }
+
+    free(next);
+}
+
+int tournament(const struct strategy** strategies, int count, struct tournament_options* options) {
+    if (count < 2) {
+        fprintf(stderr, "a tournament needs at least 2 strategies\n");
+        return -1;
+    }
+
+    int games = options->games;
+    struct tournament_job job = {
+        .strategies = strategies,
+        .count = count,
+        .options = options,
+        .shots = malloc((size_t)count * count * games * sizeof(u16))
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, 0);
+    if (!job.shots) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    int threads = options->threads < 1 ? 1 : options->threads;
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    u64 start = time_ms();
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, worker, &job);
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    free(tids);
+
+    if (atomic_load(&job.failed)) {
+        free(job.shots);
+        return -1;
+    }
+
+    // wins[i * count + j] is how many games i won against j.
+    double* wins = calloc((size_t)count * count, sizeof(double));
+    double* strength = calloc(count, sizeof(double));
+    double* mean_shots = calloc(count, sizeof(double));
+    int* order = calloc(count, sizeof(int));
+
+    for (int a = 0; a < count; a++) {
+        for (int b = 0; b < count; b++) {
+            if (a == b)
+                continue;
+
+            const u16* a_shots = &job.shots[((size_t)a * count + b) * games];
+            const u16* b_shots = &job.shots[((size_t)b * count + a) * games];
+            for (int g = 0; g < games; g++) {
+                // The lower numbered strategy goes first in even games, and on a tie whoever went
+                // first sinks the last ship first.
+                int a_first = (a < b) == (g % 2 == 0);
+                if (a_shots[g] < b_shots[g] || (a_shots[g] == b_shots[g] && a_first))
+                    wins[a * count + b]++;
+                mean_shots[a] += a_shots[g];
+            }
+        }
+        mean_shots[a] /= (double)(count - 1) * games;
+    }
+
+    fit_strengths(wins, count, games, strength);
+
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    for (int i = 1; i < count; i++) {
+        for (int j = i; j > 0 && strength[order[j]] > strength[order[j - 1]]; j--) {
+            int t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+    }
+
+    printf("%i strategies, %i games per pairing, %.1fs\n", count, games, (time_ms() - start) / 1000.0);
+    printf("%4s  %-20s %6s  %-6s %6s %7s\n", "rank", "strategy", "elo", "95%", "win%", "shots");
+
+    for (int k = 0; k < count; k++) {
+        int i = order[k];
+        double elo = 1500 + 400 * log10(strength[i]);
+
+        // Standard error from the Fisher information of the fitted rating.
+        double information = 0, won = 0;
+        for (int j = 0; j < count; j++) {
+            if (j == i)
+                continue;
+            double p = strength[i] / (strength[i] + strength[j]);
+            information += games * p * (1 - p);
+            won += wins[i * count + j];
+        }
+        double interval = 1.96 * 400 / log(10) / sqrt(information);
+
+        printf("%4i  %-20s %6.0f  +-%-4.0f %5.1f%% %7.2f\n", k + 1, strategies[i]->name, elo, interval,
+            100 * won / ((double)games * (count - 1)), mean_shots[i]);
+    }
+
+    free(order);
+    free(mean_shots);
+    free(strength);
+    free(wins);
+    free(job.shots);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef _TOURNAMENT_H
+#define _TOURNAMENT_H
+
+#include "strategy.h"
+
+struct tournament_options {
+    // Games per pairing. Each side goes first in half of them.
+    int games;
+    int threads;
+    u64 seed;
+};
+
+// Plays every pair of strategies against each other in simulation and prints Elo ratings with
+// 95% confidence intervals. Returns -1 on failure.
+int tournament(const struct strategy** strategies, int count, struct tournament_options* options);
+
+#endif
\ No newline at end of file
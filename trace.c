@@ -0,0 +1,131 @@
+#include "trace.h"
+
+#ifdef BATTLESHIP_TRACE
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Per thread. Once full, the oldest events get overwritten.
+#define TRACE_RING_SIZE 65536
+
+struct trace_event {
+    const char* name;
+    u64 start_ticks, duration_ticks;
+};
+
+struct trace_ring {
+    struct trace_event events[TRACE_RING_SIZE];
+    // Total events ever recorded. Only the owning thread writes it.
+    _Atomic u64 count;
+    int tid;
+    struct trace_ring* next;
+};
+
+// Every thread's ring, newest first. Rings are pushed once and never freed, so the dump can walk
+// the list while threads keep recording.
+static _Atomic(struct trace_ring*) rings;
+static _Atomic int next_tid;
+
+static _Thread_local struct trace_ring* local_ring;
+
+// Events are timestamped in raw ticks, which on x86 is the TSC: reading it is a few ns where
+// clock_gettime() is closer to 40. Ticks are turned into ns at dump time against a reference
+// pair taken when the first ring is created.
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static u64 now_ticks() {
+    return __rdtsc();
+}
+#else
+static u64 now_ticks() {
+    return time_ns();
+}
+#endif
+
+static u64 base_ticks, base_ns;
+
+static void dump_at_exit() {
+    const char* path = getenv("BATTLESHIP_TRACE_FILE");
+    if (path && *path && trace_dump(path) == 0)
+        fprintf(stderr, "trace written to %s\n", path);
+}
+
+static struct trace_ring* create_ring() {
+    struct trace_ring* ring = calloc(1, sizeof(struct trace_ring));
+    if (!ring)
+        abort();
+
+    ring->tid = atomic_fetch_add(&next_tid, 1) + 1;
+    if (ring->tid == 1) {
+        base_ns = time_ns();
+        base_ticks = now_ticks();
+        atexit(dump_at_exit);
+    }
+
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring));
+
+    return ring;
+}
+
+struct trace_scope trace_scope_begin(const char* name) {
+    return (struct trace_scope){ .name = name, .start_ticks = now_ticks() };
+}
+
+void trace_scope_end(struct trace_scope* scope) {
+    u64 end = now_ticks();
+
+    struct trace_ring* ring = local_ring;
+    if (!ring)
+        ring = local_ring = create_ring();
+
+    u64 count = atomic_load_explicit(&ring->count, memory_order_relaxed);
+    ring->events[count % TRACE_RING_SIZE] = (struct trace_event){
+        .name = scope->name,
+        .start_ticks = scope->start_ticks,
+        .duration_ticks = end - scope->start_ticks
+    };
+    atomic_store_explicit(&ring->count, count + 1, memory_order_release);
+}
+
+int trace_dump(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        perror("trace file error");
+        return -1;
+    }
+
+    // Measure how fast ticks go against the clock since the first event.
+    double ns_per_tick = 1.0;
+    u64 ticks = now_ticks() - base_ticks;
+    if (ticks > 0)
+        ns_per_tick = (double)(time_ns() - base_ns) / ticks;
+
+    fprintf(file, "{\"traceEvents\":[");
+
+    int first = 1;
+    for (struct trace_ring* ring = atomic_load(&rings); ring; ring = ring->next) {
+        u64 count = atomic_load_explicit(&ring->count, memory_order_acquire);
+        u64 start = count > TRACE_RING_SIZE ? count - TRACE_RING_SIZE : 0;
+
+        for (u64 i = start; i < count; i++) {
+            struct trace_event* event = &ring->events[i % TRACE_RING_SIZE];
+            fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%i,\"tid\":%i}",
+                first ? "" : ",",
+                event->name,
+                (base_ns + ((double)event->start_ticks - base_ticks) * ns_per_tick) / 1000.0,
+                event->duration_ticks * ns_per_tick / 1000.0,
+                (int)getpid(),
+                ring->tid);
+            first = 0;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    return fclose(file) ? -1 : 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+// Lightweight scope tracing. Build with -DBATTLESHIP_TRACE=ON to record events, otherwise every
+// macro here compiles to nothing.
+//
+// Each thread records into its own ring buffer, so recording never takes a lock. The rings are
+// written out as Chrome trace-event JSON (load it in chrome://tracing or Perfetto) by
+// trace_dump(), and at exit if BATTLESHIP_TRACE_FILE is set.
+
+#ifdef BATTLESHIP_TRACE
+
+#include "util.h"
+
+struct trace_scope {
+    const char* name;
+    u64 start_ticks;
+};
+
+struct trace_scope trace_scope_begin(const char* name);
+void trace_scope_end(struct trace_scope* scope);
+
+// Writes every recorded event to path. Returns -1 if the file can't be written.
+int trace_dump(const char* path);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// Records the time from here to the end of the enclosing block.
+#define TRACE_SCOPE(name)                                                       \
+    struct trace_scope TRACE_CONCAT(trace_scope_, __LINE__)                     \
+        __attribute__((cleanup(trace_scope_end))) = trace_scope_begin(name)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+
+static inline int trace_dump(const char* path) {
+    (void)path;
+    return 0;
+}
+
+#endif
+
+#endif
\ No newline at end of file
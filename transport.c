@@ -0,0 +1,467 @@
+#include "transport.h"
+#include "mpsc.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// TCP
+
+static ssize_t tcp_send(struct connection* conn, const void* buf, size_t length) {
+    ssize_t status;
+    while ((status = send(conn->fd, buf, length, 0)) < 0 && errno == EINTR);
+    return status;
+}
+
+static ssize_t tcp_recv(struct connection* conn, void* buf, size_t length, int timeout_ms) {
+    struct pollfd pfd = { .fd = conn->fd, .events = POLLIN };
+    int status;
+
+    while ((status = poll(&pfd, 1, timeout_ms)) < 0 && errno == EINTR);
+    if (status < 0)
+        return -1;
+    if (status == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    ssize_t received;
+    while ((received = recv(conn->fd, buf, length, 0)) < 0 && errno == EINTR);
+    return received;
+}
+
+static void tcp_close(struct connection* conn) {
+    close(conn->fd);
+    conn->fd = -1;
+}
+
+static const struct transport tcp_transport = {
+    .send = tcp_send,
+    .recv = tcp_recv,
+    .close = tcp_close
+};
+
+void tcp_connection_init(struct connection* conn, enum peer_type type, int fd) {
+    memset(conn, 0, sizeof(struct connection));
+    conn->type = type;
+    conn->transport = &tcp_transport;
+    conn->fd = fd;
+
+    // Every packet is a few bytes the other side is waiting on, so holding them back to fill a
+    // segment only adds a round trip to each move.
+    int yes = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof yes) < 0)
+        perror("setsockopt error");
+}
+
+// In-process queue
+
+// Bytes travel between threads in fixed size chunks over lock-free queues, so neither side ever
+// takes a lock to send or receive.
+#define MEM_CHUNK_SIZE 62
+#define MEM_QUEUE_CHUNKS 256
+#define MEM_BATCH 16
+
+struct mem_chunk {
+    // 0 marks the end of the stream.
+    u16 length;
+    char data[MEM_CHUNK_SIZE];
+};
+
+struct mem_end {
+    struct mem_shared* shared;
+    struct mpsc_queue* in;
+    struct mpsc_queue* out;
+    // Chunks taken off `in` that haven't been handed out yet.
+    struct mem_chunk batch[MEM_BATCH];
+    size_t count, index, offset;
+};
+
+struct mem_shared {
+    // queues[0] carries server -> client, queues[1] client -> server.
+    struct mpsc_queue queues[2];
+    struct mem_end ends[2];
+    _Atomic int closed;
+    // Freed once both ends are closed.
+    _Atomic int refs;
+};
+
+static ssize_t mem_send(struct connection* conn, const void* buf, size_t length) {
+    struct mem_end* end = conn->impl;
+    struct mem_shared* shared = end->shared;
+    size_t sent = 0;
+
+    while (sent < length) {
+        struct mem_chunk chunk;
+        chunk.length = (u16)(length - sent < MEM_CHUNK_SIZE ? length - sent : MEM_CHUNK_SIZE);
+        memcpy(chunk.data, (const char*)buf + sent, chunk.length);
+
+        // The queue only fills up if the other side stopped reading, so just wait it out.
+        while (mpsc_push(end->out, &chunk)) {
+            if (atomic_load(&shared->closed)) {
+                errno = EPIPE;
+                return -1;
+            }
+            sched_yield();
+        }
+
+        sent += chunk.length;
+    }
+
+    return (ssize_t)sent;
+}
+
+static ssize_t mem_recv(struct connection* conn, void* buf, size_t length, int timeout_ms) {
+    struct mem_end* end = conn->impl;
+    size_t received = 0;
+
+    while (received < length) {
+        if (end->index == end->count) {
+            // Hand back what we have rather than wait for more.
+            if (received > 0)
+                break;
+
+            if (mpsc_wait(end->in, timeout_ms)) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+
+            end->count = mpsc_pop_batch(end->in, end->batch, MEM_BATCH);
+            end->index = 0;
+            end->offset = 0;
+            continue;
+        }
+
+        struct mem_chunk* chunk = &end->batch[end->index];
+        if (chunk->length == 0)
+            break;
+
+        size_t n = chunk->length - end->offset;
+        if (n > length - received)
+            n = length - received;
+
+        memcpy((char*)buf + received, chunk->data + end->offset, n);
+        received += n;
+        end->offset += n;
+
+        if (end->offset == chunk->length) {
+            end->index++;
+            end->offset = 0;
+        }
+    }
+
+    return (ssize_t)received;
+}
+
+static void mem_close(struct connection* conn) {
+    struct mem_end* end = conn->impl;
+    struct mem_shared* shared = end->shared;
+
+    atomic_store(&shared->closed, 1);
+
+    // Tell the other side we're gone, unless it's gone already and nobody will read this.
+    struct mem_chunk eof = { .length = 0 };
+    while (mpsc_push(end->out, &eof) && atomic_load(&shared->refs) > 1)
+        sched_yield();
+
+    if (atomic_fetch_sub(&shared->refs, 1) == 1) {
+        mpsc_destroy(&shared->queues[0]);
+        mpsc_destroy(&shared->queues[1]);
+        free(shared);
+    }
+
+    conn->impl = NULL;
+}
+
+static const struct transport mem_transport = {
+    .send = mem_send,
+    .recv = mem_recv,
+    .close = mem_close
+};
+
+int mem_connection_pair(struct connection* server, struct connection* client) {
+    struct mem_shared* shared = calloc(1, sizeof(struct mem_shared));
+    if (!shared)
+        return -1;
+
+    if (mpsc_init(&shared->queues[0], MEM_QUEUE_CHUNKS, sizeof(struct mem_chunk))
+        || mpsc_init(&shared->queues[1], MEM_QUEUE_CHUNKS, sizeof(struct mem_chunk))) {
+        mpsc_destroy(&shared->queues[0]);
+        mpsc_destroy(&shared->queues[1]);
+        free(shared);
+        return -1;
+    }
+
+    shared->ends[0].shared = shared->ends[1].shared = shared;
+    shared->ends[0].out = shared->ends[1].in = &shared->queues[0];
+    shared->ends[1].out = shared->ends[0].in = &shared->queues[1];
+    atomic_init(&shared->refs, 2);
+
+    memset(server, 0, sizeof(struct connection));
+    server->type = PEER_SERVER;
+    server->transport = &mem_transport;
+    server->fd = -1;
+    server->impl = &shared->ends[0];
+
+    memset(client, 0, sizeof(struct connection));
+    client->type = PEER_CLIENT;
+    client->transport = &mem_transport;
+    client->fd = -1;
+    client->impl = &shared->ends[1];
+
+    return 0;
+}
+
+// Shared memory
+
+#define SHM_RING_SIZE 4096
+
+// Single producer, single consumer. Each index lives on its own cache line so the two sides
+// don't fight over it.
+struct shm_ring {
+    _Alignas(64) _Atomic u32 head;
+    _Alignas(64) _Atomic u32 tail;
+    _Alignas(64) _Atomic int closed;
+    char data[SHM_RING_SIZE];
+};
+
+struct shm_region {
+    // rings[0] carries server -> client, rings[1] client -> server.
+    struct shm_ring rings[2];
+    // Set by the client once it has the region mapped, after which the name is its to take down.
+    _Alignas(64) _Atomic int attached;
+};
+
+// Regions this process created that no client may have joined yet. Until one joins, the name is
+// ours to take down, when the connection closes or at the latest when the process exits, since a
+// server gives up on a client with exit().
+struct shm_unjoined {
+    struct shm_region* region;
+    char name[256];
+    ino_t ino;
+    struct shm_unjoined* next;
+};
+
+static struct shm_unjoined* unjoined;
+static pthread_mutex_t unjoined_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void shm_unlink_unjoined(struct shm_unjoined* entry) {
+    if (atomic_load_explicit(&entry->region->attached, memory_order_acquire))
+        return;
+
+    // Another server may have cleared the name out and taken it over since, so only take it down
+    // if it's still our region.
+    struct stat st;
+    int fd = shm_open(entry->name, O_RDWR, 0);
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_ino == entry->ino)
+        shm_unlink(entry->name);
+    if (fd >= 0)
+        close(fd);
+}
+
+static void shm_unlink_all_unjoined(void) {
+    pthread_mutex_lock(&unjoined_lock);
+    for (struct shm_unjoined* entry = unjoined; entry; entry = entry->next)
+        shm_unlink_unjoined(entry);
+    pthread_mutex_unlock(&unjoined_lock);
+}
+
+// Stops tracking a region, taking its name down first if nobody joined.
+static void shm_forget(struct shm_region* region) {
+    pthread_mutex_lock(&unjoined_lock);
+    for (struct shm_unjoined** link = &unjoined; *link; link = &(*link)->next) {
+        if ((*link)->region == region) {
+            struct shm_unjoined* entry = *link;
+            *link = entry->next;
+            shm_unlink_unjoined(entry);
+            free(entry);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&unjoined_lock);
+}
+
+// Waits for the other side to make progress. Spins briefly since the peer is usually about to
+// answer, then backs off so an idle game doesn't burn a core.
+static void shm_backoff(int* spins) {
+    if (++*spins < 1000) {
+        sched_yield();
+        return;
+    }
+
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 100000 };
+    nanosleep(&ts, NULL);
+}
+
+static ssize_t shm_send(struct connection* conn, const void* buf, size_t length) {
+    struct shm_region* region = conn->impl;
+    struct shm_ring* ring = &region->rings[conn->type == PEER_SERVER ? 0 : 1];
+    size_t sent = 0;
+    int spins = 0;
+
+    while (sent < length) {
+        u32 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        u32 tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            errno = EPIPE;
+            return -1;
+        }
+
+        if (head - tail == SHM_RING_SIZE) {
+            shm_backoff(&spins);
+            continue;
+        }
+
+        while (sent < length && head - tail < SHM_RING_SIZE)
+            ring->data[head++ % SHM_RING_SIZE] = ((const char*)buf)[sent++];
+
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+
+    return (ssize_t)sent;
+}
+
+static ssize_t shm_recv(struct connection* conn, void* buf, size_t length, int timeout_ms) {
+    struct shm_region* region = conn->impl;
+    struct shm_ring* ring = &region->rings[conn->type == PEER_SERVER ? 1 : 0];
+    u64 deadline = timeout_ms < 0 ? 0 : time_ms() + timeout_ms;
+    int spins = 0;
+
+    while (1) {
+        u32 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        u32 head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        if (head == tail) {
+            if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+                // Closing happens after the last send, so check once more for stragglers.
+                if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail)
+                    return 0;
+                continue;
+            }
+
+            if (deadline && time_ms() >= deadline) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+
+            shm_backoff(&spins);
+            continue;
+        }
+
+        size_t received = 0;
+        while (received < length && tail != head)
+            ((char*)buf)[received++] = ring->data[tail++ % SHM_RING_SIZE];
+
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        return (ssize_t)received;
+    }
+}
+
+static void shm_close(struct connection* conn) {
+    struct shm_region* region = conn->impl;
+    if (conn->type == PEER_SERVER)
+        shm_forget(region);
+
+    atomic_store_explicit(&region->rings[0].closed, 1, memory_order_release);
+    atomic_store_explicit(&region->rings[1].closed, 1, memory_order_release);
+
+    munmap(region, sizeof(struct shm_region));
+    conn->impl = NULL;
+}
+
+static const struct transport shm_transport = {
+    .send = shm_send,
+    .recv = shm_recv,
+    .close = shm_close
+};
+
+static int shm_connection_map(struct connection* conn, enum peer_type type, int fd) {
+    void* region = mmap(NULL, sizeof(struct shm_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (region == MAP_FAILED) {
+        perror("mmap error");
+        return -1;
+    }
+
+    memset(conn, 0, sizeof(struct connection));
+    conn->type = type;
+    conn->transport = &shm_transport;
+    conn->fd = -1;
+    conn->impl = region;
+    return 0;
+}
+
+static void register_unlink_at_exit(void) {
+    atexit(shm_unlink_all_unjoined);
+}
+
+int shm_connection_create(struct connection* conn, const char* name) {
+    // Clear out whatever a previous server left behind.
+    shm_unlink(name);
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("shm_open error");
+        return -1;
+    }
+
+    // A fresh region is zero filled, which is an empty, open ring.
+    struct stat st;
+    struct shm_unjoined* entry = malloc(sizeof *entry);
+    if (!entry || ftruncate(fd, sizeof(struct shm_region)) < 0 || fstat(fd, &st) < 0) {
+        perror("shm error");
+        free(entry);
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    if (shm_connection_map(conn, PEER_SERVER, fd)) {
+        free(entry);
+        shm_unlink(name);
+        return -1;
+    }
+
+    static pthread_once_t registered = PTHREAD_ONCE_INIT;
+    pthread_once(&registered, register_unlink_at_exit);
+
+    entry->region = conn->impl;
+    snprintf(entry->name, sizeof entry->name, "%s", name);
+    entry->ino = st.st_ino;
+    pthread_mutex_lock(&unjoined_lock);
+    entry->next = unjoined;
+    unjoined = entry;
+    pthread_mutex_unlock(&unjoined_lock);
+    return 0;
+}
+
+int shm_connection_open(struct connection* conn, const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        perror("shm_open error");
+        return -1;
+    }
+
+    if (shm_connection_map(conn, PEER_CLIENT, fd))
+        return -1;
+
+    // Nobody else should be able to join this game, so take the name down right away. The server
+    // leaves it to us from here.
+    atomic_store_explicit(&((struct shm_region*)conn->impl)->attached, 1, memory_order_release);
+    shm_unlink(name);
+    return 0;
+}
\ No newline at end of file
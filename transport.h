@@ -0,0 +1,20 @@
+#ifndef _TRANSPORT_H
+#define _TRANSPORT_H
+
+#include "network.h"
+
+// A connection over a connected TCP socket.
+void tcp_connection_init(struct connection* conn, enum peer_type type, int fd);
+
+// Two connected ends of an in-process byte queue, for peers running on different threads of the
+// same process. Returns -1 on failure.
+int mem_connection_pair(struct connection* server, struct connection* client);
+
+// A connection over a pair of shared memory rings, for peers in different processes on the same
+// host. The server creates the named region and the client opens it. The client takes the name
+// down as soon as it joins. Until then the server does, when the connection closes or the process
+// exits. Returns -1 on failure.
+int shm_connection_create(struct connection* conn, const char* name);
+int shm_connection_open(struct connection* conn, const char* name);
+
+#endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 void skipline() {
     char* line = NULL;
@@ -14,4 +15,40 @@ int getcharline() {
     int chr = getchar();
     skipline();
     return chr;
+}
+
+u64 time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+u64 time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void rng_seed(struct rng* rng, u64 seed) {
+    // Run the seed through splitmix64 so nearby seeds give unrelated streams and 0 is fine.
+    u64 z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    rng->state = z ? z : 1;
+}
+
+u32 rng_next(struct rng* rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (u32)((rng->state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+u32 rng_range(struct rng* rng, u32 n) {
+    return (u32)(((u64)rng_next(rng) * n) >> 32);
+}
+
+double rng_double(struct rng* rng) {
+    return rng_next(rng) / 4294967296.0;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 typedef uint8_t u8;
 typedef uint16_t u16;
 typedef uint32_t u32;
+typedef uint64_t u64;
 typedef int8_t i8;
 typedef int16_t i16;
 typedef int32_t i32;
@@ -13,4 +14,22 @@ typedef int32_t i32;
 void skipline();
 int getcharline();
 
+// Milliseconds on a monotonic clock.
+u64 time_ms();
+// Nanoseconds on the same clock.
+u64 time_ns();
+
+// Small seedable random number generator (xorshift64*), for anything that needs reproducible
+// results or its own stream per thread.
+struct rng {
+    u64 state;
+};
+
+void rng_seed(struct rng* rng, u64 seed);
+u32 rng_next(struct rng* rng);
+// Uniform in [0, n).
+u32 rng_range(struct rng* rng, u32 n);
+// Uniform in [0, 1).
+double rng_double(struct rng* rng);
+
 #endif
\ No newline at end of file